@@ -4,6 +4,24 @@
 #include <Preferences.h>
 #include <algorithm>
 #include <cmath>
+#include <Utils.h>
+
+// Conversion settings of one 4-20 mA level transducer.
+struct LevelChannelCalibration {
+    float zeroCurrentMa = 4.0f;
+    float fullScaleCurrentMa = 20.0f;
+    float fullScaleHeightMm = 5000.0f;
+    float senseResistorOhms = 150.0f;
+    float senseGain = 1.0f;
+    float densityFactor = 1.0f;
+
+    bool operator==(const LevelChannelCalibration& other) const {
+        return zeroCurrentMa == other.zeroCurrentMa && fullScaleCurrentMa == other.fullScaleCurrentMa &&
+               fullScaleHeightMm == other.fullScaleHeightMm && senseResistorOhms == other.senseResistorOhms &&
+               senseGain == other.senseGain && densityFactor == other.densityFactor;
+    }
+    bool operator!=(const LevelChannelCalibration& other) const { return !(*this == other); }
+};
 
 class ConfigService {
   public:
@@ -41,7 +59,7 @@ class ConfigService {
 
     float densityFactor() const { return _densityFactor; }
     void setDensityFactor(float value) {
-        value = (value <= 0.0f) ? 1.0f : value;
+        value = validDensityFactor(value);
         if (fabsf(_densityFactor - value) > 0.0001f) {
             _densityFactor = value;
             persist();
@@ -57,6 +75,45 @@ class ConfigService {
         }
     }
 
+    // With adaptive oversampling the count above is the ceiling and each
+    // reading uses the fewest samples (not below the minimum) that keep the
+    // standard error under the target.
+    bool levelAdaptiveOversample() const { return _adaptiveOversample; }
+    void setLevelAdaptiveOversample(bool enabled) {
+        if (enabled != _adaptiveOversample) {
+            _adaptiveOversample = enabled;
+            persist();
+        }
+    }
+
+    uint8_t levelOversampleMin() const { return _oversampleMin; }
+    void setLevelOversampleMin(uint8_t count) {
+        count = std::max<uint8_t>(3, std::min<uint8_t>(64, count));
+        if (count != _oversampleMin) {
+            _oversampleMin = count;
+            persist();
+        }
+    }
+
+    float levelTargetErrorMm() const { return _targetErrorMm; }
+    void setLevelTargetErrorMm(float value) {
+        value = constrainFloat(value, 0.05f, 50.0f);
+        if (fabsf(_targetErrorMm - value) > 0.0001f) {
+            _targetErrorMm = value;
+            persist();
+        }
+    }
+
+    // Conversion rate of the continuous level ADC; applied at boot.
+    uint32_t levelSampleRateHz() const { return _levelSampleRateHz; }
+    void setLevelSampleRateHz(uint32_t value) {
+        value = clampInterval(value, 20000, 200000);
+        if (value != _levelSampleRateHz) {
+            _levelSampleRateHz = value;
+            persist();
+        }
+    }
+
     float zeroCurrentMa() const { return _zeroCurrentMa; }
     void setZeroCurrentMa(float value) {
         value = constrainFloat(value, 0.0f, 10.0f);
@@ -129,6 +186,62 @@ class ConfigService {
         }
     }
 
+    // Adaptive Kalman level tracker; alpha-beta (gains above) when off.
+    bool levelKalmanFilter() const { return _levelKalman; }
+    void setLevelKalmanFilter(bool enabled) {
+        if (enabled != _levelKalman) {
+            _levelKalman = enabled;
+            persist();
+        }
+    }
+
+    // Channel 0 is the primary transducer and maps onto the settings above;
+    // the other scanned channels keep their own set.
+    LevelChannelCalibration levelCalibration(size_t channel) const {
+        if (channel == 0) {
+            LevelChannelCalibration cal;
+            cal.zeroCurrentMa = _zeroCurrentMa;
+            cal.fullScaleCurrentMa = _fullScaleCurrentMa;
+            cal.fullScaleHeightMm = _fullScaleHeightMm;
+            cal.senseResistorOhms = _senseResistorOhms;
+            cal.senseGain = _senseGain;
+            cal.densityFactor = _densityFactor;
+            return cal;
+        }
+        if (channel >= utils::MAX_LEVEL_CHANNELS) {
+            return LevelChannelCalibration();
+        }
+        return _levelCalibration[channel - 1];
+    }
+    void setLevelCalibration(size_t channel, LevelChannelCalibration cal) {
+        if (channel >= utils::MAX_LEVEL_CHANNELS) {
+            return;
+        }
+        cal = constrainCalibration(cal);
+        if (cal == levelCalibration(channel)) {
+            return;
+        }
+        if (channel == 0) {
+            _zeroCurrentMa = cal.zeroCurrentMa;
+            _fullScaleCurrentMa = cal.fullScaleCurrentMa;
+            _fullScaleHeightMm = cal.fullScaleHeightMm;
+            _senseResistorOhms = cal.senseResistorOhms;
+            _senseGain = cal.senseGain;
+            _densityFactor = cal.densityFactor;
+        } else {
+            _levelCalibration[channel - 1] = cal;
+        }
+        persist();
+    }
+
+    bool reciprocalFlow() const { return _reciprocalFlow; }
+    void setReciprocalFlow(bool enabled) {
+        if (enabled != _reciprocalFlow) {
+            _reciprocalFlow = enabled;
+            persist();
+        }
+    }
+
   private:
     uint32_t clampInterval(uint32_t value, uint32_t minValue, uint32_t maxValue) const {
         if (value < minValue) {
@@ -150,14 +263,33 @@ class ConfigService {
         return value;
     }
 
+    // A NaN or infinite factor would turn every later reading into NaN.
+    static float validDensityFactor(float value) {
+        return (std::isfinite(value) && value > 0.0f) ? value : 1.0f;
+    }
+
+    LevelChannelCalibration constrainCalibration(LevelChannelCalibration cal) const {
+        cal.zeroCurrentMa = constrainFloat(cal.zeroCurrentMa, 0.0f, 10.0f);
+        cal.fullScaleCurrentMa = constrainFloat(cal.fullScaleCurrentMa, 12.0f, 30.0f);
+        cal.fullScaleHeightMm = constrainFloat(cal.fullScaleHeightMm, 500.0f, 10000.0f);
+        cal.senseResistorOhms = constrainFloat(cal.senseResistorOhms, 10.0f, 1000.0f);
+        cal.senseGain = constrainFloat(cal.senseGain, 0.1f, 10.0f);
+        cal.densityFactor = validDensityFactor(cal.densityFactor);
+        return cal;
+    }
+
     void loadFromStorage() {
         if (!_prefsInitialized) {
             return;
         }
         _sensorIntervalMs = _prefs.getULong("sens_int", _sensorIntervalMs);
         _loggingIntervalMs = _prefs.getULong("log_int", _loggingIntervalMs);
-        _densityFactor = _prefs.getFloat("density", _densityFactor);
+        _densityFactor = validDensityFactor(_prefs.getFloat("density", _densityFactor));
         _oversampleCount = static_cast<uint8_t>(_prefs.getUInt("os_cnt", _oversampleCount));
+        _adaptiveOversample = _prefs.getBool("os_adapt", _adaptiveOversample);
+        _oversampleMin = static_cast<uint8_t>(_prefs.getUInt("os_min", _oversampleMin));
+        _targetErrorMm = _prefs.getFloat("os_se_mm", _targetErrorMm);
+        _levelSampleRateHz = _prefs.getULong("lvl_rate", _levelSampleRateHz);
         _zeroCurrentMa = _prefs.getFloat("zero_ma", _zeroCurrentMa);
         _fullScaleCurrentMa = _prefs.getFloat("full_ma", _fullScaleCurrentMa);
         _fullScaleHeightMm = _prefs.getFloat("full_mm", _fullScaleHeightMm);
@@ -166,6 +298,14 @@ class ConfigService {
         _senseGain = _prefs.getFloat("sense_g", _senseGain);
         _alphaGain = _prefs.getFloat("alpha", _alphaGain);
         _betaGain = _prefs.getFloat("beta", _betaGain);
+        _levelKalman = _prefs.getBool("lvl_kalman", _levelKalman);
+        _reciprocalFlow = _prefs.getBool("flow_recip", _reciprocalFlow);
+        if (_prefs.getBytesLength("lvl_cal") == sizeof(_levelCalibration)) {
+            _prefs.getBytes("lvl_cal", _levelCalibration, sizeof(_levelCalibration));
+            for (LevelChannelCalibration& cal : _levelCalibration) {
+                cal = constrainCalibration(cal);
+            }
+        }
     }
 
     void persist() {
@@ -176,6 +316,10 @@ class ConfigService {
         _prefs.putULong("log_int", _loggingIntervalMs);
         _prefs.putFloat("density", _densityFactor);
         _prefs.putUInt("os_cnt", _oversampleCount);
+        _prefs.putBool("os_adapt", _adaptiveOversample);
+        _prefs.putUInt("os_min", _oversampleMin);
+        _prefs.putFloat("os_se_mm", _targetErrorMm);
+        _prefs.putULong("lvl_rate", _levelSampleRateHz);
         _prefs.putFloat("zero_ma", _zeroCurrentMa);
         _prefs.putFloat("full_ma", _fullScaleCurrentMa);
         _prefs.putFloat("full_mm", _fullScaleHeightMm);
@@ -184,6 +328,9 @@ class ConfigService {
         _prefs.putFloat("sense_g", _senseGain);
         _prefs.putFloat("alpha", _alphaGain);
         _prefs.putFloat("beta", _betaGain);
+        _prefs.putBool("lvl_kalman", _levelKalman);
+        _prefs.putBool("flow_recip", _reciprocalFlow);
+        _prefs.putBytes("lvl_cal", _levelCalibration, sizeof(_levelCalibration));
     }
 
     Preferences _prefs;
@@ -192,6 +339,10 @@ class ConfigService {
     uint32_t _loggingIntervalMs = 1000;
     float _densityFactor = 1.0f;
     uint8_t _oversampleCount = 10;
+    bool _adaptiveOversample = true;
+    uint8_t _oversampleMin = 5;
+    float _targetErrorMm = 1.0f;
+    uint32_t _levelSampleRateHz = 20000;
     float _zeroCurrentMa = 4.0f;
     float _fullScaleCurrentMa = 20.0f;
     float _fullScaleHeightMm = 5000.0f;
@@ -200,5 +351,8 @@ class ConfigService {
     float _senseGain = 1.0f;
     float _alphaGain = 0.4f;
     float _betaGain = 0.02f;
+    bool _levelKalman = true;
+    bool _reciprocalFlow = true;
+    LevelChannelCalibration _levelCalibration[utils::MAX_LEVEL_CHANNELS - 1];
 };
 
@@ -1,27 +1,69 @@
 #include "FlowSensor.h"
 
-#include <cstring>
-
-#include <driver/gpio.h>
+#include <algorithm>
 
 namespace {
-portMUX_TYPE flowSensorMux = portMUX_INITIALIZER_UNLOCKED;
+portMUX_TYPE unitAllocationMux = portMUX_INITIALIZER_UNLOCKED;
+UnitAllocator pcntUnits(FlowSensor::MAX_INSTANCES);
+bool isrServiceInstalled = false;
 }
 
+constexpr size_t FlowSensor::MAX_INSTANCES;
+constexpr size_t FlowSensor::MAX_PERIOD_HISTORY;
+constexpr size_t FlowSensor::DEFAULT_PERIOD_HISTORY;
+constexpr int16_t FlowSensor::COUNTER_LIMIT;
+
 FlowSensor::FlowSensor()
     : _pin(0),
       _unit(PCNT_UNIT_0),
+      _active(false),
+      _capture(nullptr),
+      _counter(COUNTER_LIMIT),
       _pulseCount(0),
+      _edgeCount(0),
+      _reportedEdgeCount(0),
+      _edgeResyncs(0),
+      _reportedEdgeResyncs(0),
+      _edgeGranularity(1),
       _lastPeriodMicros(0),
       _lastTimestampMicros(0),
+      _periodHistory{},
+      _periodHistorySize(DEFAULT_PERIOD_HISTORY),
       _periodCount(0),
-      _periodIndex(0) {
-    memset((void*)_periodHistory, 0, sizeof(_periodHistory));
+      _periodIndex(0) {}
+
+FlowSensor::~FlowSensor() {
+    end();
+}
+
+bool FlowSensor::allocateUnit(pcnt_unit_t& unit) {
+    uint32_t index = 0;
+    portENTER_CRITICAL(&unitAllocationMux);
+    bool allocated = pcntUnits.claim(index);
+    portEXIT_CRITICAL(&unitAllocationMux);
+    if (allocated) {
+        unit = static_cast<pcnt_unit_t>(index);
+    }
+    return allocated;
+}
+
+void FlowSensor::releaseUnit(pcnt_unit_t unit) {
+    portENTER_CRITICAL(&unitAllocationMux);
+    pcntUnits.release(static_cast<uint32_t>(unit));
+    portEXIT_CRITICAL(&unitAllocationMux);
 }
 
-void FlowSensor::begin(uint8_t pin, pcnt_unit_t unit) {
+bool FlowSensor::begin(uint8_t pin, PulseCapture* capture) {
+    if (_active) {
+        end();
+    }
+    if (!allocateUnit(_unit)) {
+        Serial.println("No free PCNT unit for flow sensor");
+        return false;
+    }
+    _active = true;
     _pin = pin;
-    _unit = unit;
+    _capture = capture;
 
     pinMode(_pin, INPUT);
 
@@ -30,7 +72,7 @@ void FlowSensor::begin(uint8_t pin, pcnt_unit_t unit) {
     pcntConfig.ctrl_gpio_num = PCNT_PIN_NOT_USED;
     pcntConfig.unit = _unit;
     pcntConfig.channel = PCNT_CHANNEL_0;
-    pcntConfig.counter_h_lim = 32000;
+    pcntConfig.counter_h_lim = COUNTER_LIMIT;
     pcntConfig.counter_l_lim = -1;
     pcntConfig.pos_mode = PCNT_COUNT_INC;
     pcntConfig.neg_mode = PCNT_COUNT_DIS;
@@ -42,6 +84,15 @@ void FlowSensor::begin(uint8_t pin, pcnt_unit_t unit) {
     pcnt_filter_enable(_unit);
     pcnt_counter_pause(_unit);
     pcnt_counter_clear(_unit);
+    _counter.reset();
+
+    // The counter wraps to zero at the high limit; the event ISR folds each
+    // wrap into the 64-bit total so long intervals and high rates lose nothing.
+    pcnt_event_enable(_unit, PCNT_EVT_H_LIM);
+    if (!isrServiceInstalled) {
+        isrServiceInstalled = pcnt_isr_service_install(0) == ESP_OK;
+    }
+    pcnt_isr_handler_add(_unit, FlowSensor::onCounterLimit, this);
     pcnt_counter_resume(_unit);
 
     _pulseCount = 0;
@@ -50,72 +101,138 @@ void FlowSensor::begin(uint8_t pin, pcnt_unit_t unit) {
     _periodCount = 0;
     _periodIndex = 0;
 
-    attachInterruptArg(digitalPinToInterrupt(_pin), FlowSensor::isrHandler, this, RISING);
+    if (_capture != nullptr && !_capture->begin(_pin)) {
+        Serial.println("Flow pulse capture unavailable, periods disabled");
+        _capture = nullptr;
+    }
+    _edgeCount = _capture != nullptr ? _capture->edgeCount() : 0;
+    _reportedEdgeCount = _edgeCount;
+    _edgeResyncs = _capture != nullptr ? _capture->edgeResyncs() : 0;
+    _reportedEdgeResyncs = _edgeResyncs;
+    return true;
+}
+
+void FlowSensor::end() {
+    if (!_active) {
+        return;
+    }
+    if (_capture != nullptr) {
+        _capture->end();
+        _capture = nullptr;
+    }
+    pcnt_counter_pause(_unit);
+    pcnt_isr_handler_remove(_unit);
+    releaseUnit(_unit);
+    _active = false;
 }
 
 void FlowSensor::reset() {
-    portENTER_CRITICAL(&flowSensorMux);
+    if (_capture != nullptr) {
+        uint32_t discarded[MAX_PERIOD_HISTORY];
+        _capture->drain(discarded, MAX_PERIOD_HISTORY);
+        PeriodStatistics discardedStats;
+        _capture->takeStatistics(discardedStats);
+    }
+    pcnt_counter_pause(_unit);
+    pcnt_counter_clear(_unit);
+    _counter.reset();
+    pcnt_counter_resume(_unit);
     _pulseCount = 0;
     _lastPeriodMicros = 0;
     _lastTimestampMicros = micros();
     _periodCount = 0;
     _periodIndex = 0;
-    memset((void*)_periodHistory, 0, sizeof(_periodHistory));
-    pcnt_counter_clear(_unit);
-    portEXIT_CRITICAL(&flowSensorMux);
+    _periodHistory.fill(0);
 }
 
-FlowSensor::Snapshot FlowSensor::takeSnapshot() const {
+void FlowSensor::setPeriodHistorySize(size_t size) {
+    size = std::max<size_t>(1, std::min(size, MAX_PERIOD_HISTORY));
+    if (size == _periodHistorySize) {
+        return;
+    }
+    _periodHistorySize = size;
+    _periodCount = 0;
+    _periodIndex = 0;
+}
+
+FlowSensor::Snapshot FlowSensor::takeSnapshot() {
     Snapshot snap;
     updateFromCounter();
+    fillSnapshot(snap);
+    return snap;
+}
+
+void FlowSensor::takeSnapshots(FlowSensor* sensors, size_t count, Snapshot* out) {
+    for (size_t i = 0; i < count; ++i) {
+        sensors[i].updateFromCounter();
+    }
+    for (size_t i = 0; i < count; ++i) {
+        sensors[i].fillSnapshot(out[i]);
+    }
+}
+
+void FlowSensor::fillSnapshot(Snapshot& snap) {
+    drainCapture();
+    if (_capture != nullptr) {
+        _capture->takeStatistics(snap.periodStats);
+    } else {
+        snap.periodStats.clear();
+    }
 
-    portENTER_CRITICAL(&flowSensorMux);
     snap.totalPulses = _pulseCount;
+    snap.captureEdges = _edgeCount - _reportedEdgeCount;
+    _reportedEdgeCount = _edgeCount;
+    snap.captureEdgeGranularity = _edgeGranularity;
+    snap.captureResynced = _edgeResyncs != _reportedEdgeResyncs;
+    _reportedEdgeResyncs = _edgeResyncs;
     snap.lastPeriodMicros = _lastPeriodMicros;
     snap.lastTimestampMicros = _lastTimestampMicros;
     snap.periodCount = _periodCount;
-    size_t count = _periodCount;
-    for (size_t i = 0; i < count; ++i) {
-        size_t index = (_periodIndex + PERIOD_HISTORY - count + i) % PERIOD_HISTORY;
+    for (size_t i = 0; i < _periodCount; ++i) {
+        size_t index = (_periodIndex + _periodHistorySize - _periodCount + i) % _periodHistorySize;
         snap.recentPeriods[i] = _periodHistory[index];
     }
-    for (size_t i = count; i < PERIOD_HISTORY; ++i) {
-        snap.recentPeriods[i] = 0;
-    }
-    portEXIT_CRITICAL(&flowSensorMux);
-    return snap;
 }
 
-void FlowSensor::updateFromCounter() const {
-    int16_t current = 0;
-    pcnt_get_counter_value(_unit, &current);
-    if (current != 0) {
-        pcnt_counter_clear(_unit);
-        portENTER_CRITICAL(&flowSensorMux);
-        if (current > 0) {
-            _pulseCount += static_cast<uint64_t>(current);
-        }
-        portEXIT_CRITICAL(&flowSensorMux);
+void FlowSensor::updateFromCounter() {
+    if (!_active) {
+        return;
+    }
+    pcnt_unit_t unit = _unit;
+    _pulseCount = _counter.read([unit]() {
+        int16_t current = 0;
+        pcnt_get_counter_value(unit, &current);
+        return current;
+    });
+    if (_capture != nullptr) {
+        _edgeCount = _capture->edgeCount();
+        _edgeResyncs = _capture->edgeResyncs();
+        _edgeGranularity = _capture->edgeGranularity();
     }
 }
 
-void IRAM_ATTR FlowSensor::isrHandler(void* arg) {
+void IRAM_ATTR FlowSensor::onCounterLimit(void* arg) {
     if (arg == nullptr) {
         return;
     }
-    static_cast<FlowSensor*>(arg)->handlePulse();
+    static_cast<FlowSensor*>(arg)->_counter.onOverflow();
 }
 
-void IRAM_ATTR FlowSensor::handlePulse() {
-    uint32_t now = micros();
-    portENTER_CRITICAL_ISR(&flowSensorMux);
-    _lastPeriodMicros = now - _lastTimestampMicros;
-    _lastTimestampMicros = now;
-    _periodHistory[_periodIndex] = _lastPeriodMicros;
-    _periodIndex = (_periodIndex + 1) % PERIOD_HISTORY;
-    if (_periodCount < PERIOD_HISTORY) {
-        _periodCount++;
-    }
-    portEXIT_CRITICAL_ISR(&flowSensorMux);
+void FlowSensor::drainCapture() {
+    if (_capture == nullptr) {
+        return;
+    }
+    uint32_t periods[MAX_PERIOD_HISTORY];
+    size_t count = _capture->drain(periods, _periodHistorySize);
+    for (size_t i = 0; i < count; ++i) {
+        _periodHistory[_periodIndex] = periods[i];
+        _periodIndex = (_periodIndex + 1) % _periodHistorySize;
+        if (_periodCount < _periodHistorySize) {
+            _periodCount++;
+        }
+    }
+    if (count > 0) {
+        _lastPeriodMicros = periods[count - 1];
+        _lastTimestampMicros = _capture->lastEdgeMicros();
+    }
 }
-
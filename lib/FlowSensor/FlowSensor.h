@@ -4,38 +4,78 @@
 #include <driver/pcnt.h>
 #include <array>
 
-#include <../Utils/Utils.h>
+#include <Utils.h>
+#include "OverflowCounter.h"
+#include "PulseCapture.h"
+#include "UnitAllocator.h"
 
+// Pulse periods reach FlowSensor through the capture backend's lock-free
+// ring; period history is owned by the task calling takeSnapshot(), so
+// reset() and setPeriodHistorySize() belong there too. Each instance claims
+// its own PCNT unit, so up to MAX_INSTANCES meters can run side by side.
 class FlowSensor {
   public:
-    static constexpr size_t PERIOD_HISTORY = 16;
+    static constexpr size_t MAX_INSTANCES = PCNT_UNIT_MAX;
+    static constexpr size_t MAX_PERIOD_HISTORY = 64;
+    static constexpr size_t DEFAULT_PERIOD_HISTORY = 16;
+    static constexpr int16_t COUNTER_LIMIT = 32000;
 
     struct Snapshot {
         uint64_t totalPulses = 0;
         uint32_t lastPeriodMicros = 0;
         uint32_t lastTimestampMicros = 0;
-        std::array<uint32_t, PERIOD_HISTORY> recentPeriods{};
+        std::array<uint32_t, MAX_PERIOD_HISTORY> recentPeriods{};
         size_t periodCount = 0;
+        // Every period captured since the previous snapshot.
+        PeriodStatistics periodStats;
+        // Edges the capture path saw over the same interval as the PCNT count.
+        uint32_t captureEdges = 0;
+        // Edges per capture event, and whether the capture path lost track
+        // of edges during the interval.
+        uint32_t captureEdgeGranularity = 1;
+        bool captureResynced = false;
     };
 
     FlowSensor();
+    ~FlowSensor();
 
-    void begin(uint8_t pin, pcnt_unit_t unit = PCNT_UNIT_0);
+    // PCNT counts pulses on the first free unit; the optional capture
+    // backend supplies periods. Returns false when all units are taken.
+    bool begin(uint8_t pin, PulseCapture* capture = nullptr);
+    void end();
     void reset();
-    Snapshot takeSnapshot() const;
+    bool capturing() const { return _capture != nullptr; }
+    void setPeriodHistorySize(size_t size);
+    size_t periodHistorySize() const { return _periodHistorySize; }
+    Snapshot takeSnapshot();
+    // Harvests every counter first so all channels share one time base,
+    // then fills out[i] for sensors[i].
+    static void takeSnapshots(FlowSensor* sensors, size_t count, Snapshot* out);
 
   private:
-    static void IRAM_ATTR isrHandler(void* arg);
-    void IRAM_ATTR handlePulse();
-    void updateFromCounter() const;
+    static bool allocateUnit(pcnt_unit_t& unit);
+    static void releaseUnit(pcnt_unit_t unit);
+    static void IRAM_ATTR onCounterLimit(void* arg);
+
+    void updateFromCounter();
+    void drainCapture();
+    void fillSnapshot(Snapshot& snap);
 
     uint8_t _pin;
     pcnt_unit_t _unit;
-    mutable volatile uint64_t _pulseCount;
-    volatile uint32_t _lastPeriodMicros;
-    volatile uint32_t _lastTimestampMicros;
-    volatile uint32_t _periodHistory[PERIOD_HISTORY];
-    volatile size_t _periodCount;
-    volatile size_t _periodIndex;
+    bool _active;
+    PulseCapture* _capture;
+    OverflowCounter _counter;
+    uint64_t _pulseCount;
+    uint32_t _edgeCount;
+    uint32_t _reportedEdgeCount;
+    uint32_t _edgeResyncs;
+    uint32_t _reportedEdgeResyncs;
+    uint32_t _edgeGranularity;
+    uint32_t _lastPeriodMicros;
+    uint32_t _lastTimestampMicros;
+    std::array<uint32_t, MAX_PERIOD_HISTORY> _periodHistory;
+    size_t _periodHistorySize;
+    size_t _periodCount;
+    size_t _periodIndex;
 };
-
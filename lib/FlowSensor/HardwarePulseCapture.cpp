@@ -0,0 +1,172 @@
+#include "HardwarePulseCapture.h"
+
+#include <algorithm>
+
+namespace {
+constexpr uint32_t CAPTURE_TICKS_PER_US = 80;  // capture timer runs from APB
+constexpr uint32_t PRESCALE_RESET_IDLE_US = 1000000;
+std::atomic<uint8_t> nextMcpwmChannel{0};
+}
+
+constexpr size_t GpioPulseCapture::CAPACITY;
+constexpr size_t McpwmPulseCapture::CAPACITY;
+constexpr uint32_t McpwmPulseCapture::MAX_EVENTS_PER_SECOND;
+constexpr uint32_t McpwmPulseCapture::MAX_PRESCALE;
+constexpr uint8_t McpwmPulseCapture::CHANNELS_PER_UNIT;
+constexpr uint8_t McpwmPulseCapture::MAX_CHANNELS;
+
+GpioPulseCapture::GpioPulseCapture() : _pin(0), _running(false), _lastEdgeMicros(0) {}
+
+bool GpioPulseCapture::begin(uint8_t pin) {
+    _pin = pin;
+    _ring.clear();
+    _lastEdgeMicros.store(micros(), std::memory_order_relaxed);
+    attachInterruptArg(digitalPinToInterrupt(_pin), GpioPulseCapture::isrHandler, this, RISING);
+    _running = true;
+    return true;
+}
+
+void GpioPulseCapture::end() {
+    if (_running) {
+        detachInterrupt(digitalPinToInterrupt(_pin));
+        _running = false;
+    }
+}
+
+size_t GpioPulseCapture::drain(uint32_t* periodsUs, size_t maxPeriods) {
+    return _ring.drain(periodsUs, maxPeriods);
+}
+
+uint32_t GpioPulseCapture::lastEdgeMicros() const {
+    return _lastEdgeMicros.load(std::memory_order_relaxed);
+}
+
+void IRAM_ATTR GpioPulseCapture::isrHandler(void* arg) {
+    if (arg == nullptr) {
+        return;
+    }
+    static_cast<GpioPulseCapture*>(arg)->handleEdge();
+}
+
+void IRAM_ATTR GpioPulseCapture::handleEdge() {
+    uint32_t now = micros();
+    uint32_t period = now - _lastEdgeMicros.load(std::memory_order_relaxed);
+    _edges.fetch_add(1, std::memory_order_relaxed);
+    _ring.push(period);
+    _stats.record(period);
+    _lastEdgeMicros.store(now, std::memory_order_relaxed);
+}
+
+McpwmPulseCapture::McpwmPulseCapture() : McpwmPulseCapture(MCPWM_UNIT_0, MCPWM_SELECT_CAP0) {
+    uint8_t index = nextMcpwmChannel.fetch_add(1);
+    _channelAssigned = index < MAX_CHANNELS;
+    if (_channelAssigned) {
+        _unit = static_cast<mcpwm_unit_t>(index / CHANNELS_PER_UNIT);
+        _channel = static_cast<mcpwm_capture_channel_id_t>(index % CHANNELS_PER_UNIT);
+    }
+}
+
+McpwmPulseCapture::McpwmPulseCapture(mcpwm_unit_t unit, mcpwm_capture_channel_id_t channel)
+    : _unit(unit),
+      _channel(channel),
+      _channelAssigned(true),
+      _pin(0),
+      _running(false),
+      _prescale(1),
+      _hasLastCapture(false),
+      _lastCapture(0),
+      _lastEdgeMicros(0) {}
+
+bool McpwmPulseCapture::begin(uint8_t pin) {
+    if (!_channelAssigned) {
+        return false;
+    }
+    _pin = pin;
+    mcpwm_io_signals_t signal = static_cast<mcpwm_io_signals_t>(MCPWM_CAP_0 + static_cast<int>(_channel));
+    if (mcpwm_gpio_init(_unit, signal, _pin) != ESP_OK) {
+        return false;
+    }
+    _ring.clear();
+    _lastEdgeMicros.store(micros(), std::memory_order_relaxed);
+    _running = enableChannel(1);
+    return _running;
+}
+
+void McpwmPulseCapture::end() {
+    if (_running) {
+        mcpwm_capture_disable_channel(_unit, _channel);
+        _running = false;
+    }
+}
+
+bool McpwmPulseCapture::enableChannel(uint32_t prescale) {
+    if (_running) {
+        mcpwm_capture_disable_channel(_unit, _channel);
+    }
+    _hasLastCapture = false;
+    _resyncs.fetch_add(1, std::memory_order_relaxed);
+    _prescale = prescale;
+
+    mcpwm_capture_config_t config = {};
+    config.cap_edge = MCPWM_POS_EDGE;
+    config.cap_prescale = prescale;
+    config.capture_cb = McpwmPulseCapture::onCapture;
+    config.user_data = this;
+    return mcpwm_capture_enable_channel(_unit, _channel, &config) == ESP_OK;
+}
+
+size_t McpwmPulseCapture::drain(uint32_t* periodsUs, size_t maxPeriods) {
+    size_t count = _ring.drain(periodsUs, maxPeriods);
+    if (_running) {
+        adaptPrescale(periodsUs, count);
+    }
+    return count;
+}
+
+uint32_t McpwmPulseCapture::lastEdgeMicros() const {
+    return _lastEdgeMicros.load(std::memory_order_relaxed);
+}
+
+void McpwmPulseCapture::adaptPrescale(const uint32_t* periodsUs, size_t count) {
+    uint32_t current = _prescale;
+    if (count == 0) {
+        // A large prescale at a now-slow pulse rate would starve the history.
+        if (current > 1 && micros() - lastEdgeMicros() > PRESCALE_RESET_IDLE_US) {
+            _running = enableChannel(1);
+        }
+        return;
+    }
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+        sum += periodsUs[i];
+    }
+    uint32_t meanPeriodUs = static_cast<uint32_t>(sum / count);
+    if (meanPeriodUs == 0) {
+        meanPeriodUs = 1;
+    }
+    uint64_t budgetUs = static_cast<uint64_t>(MAX_EVENTS_PER_SECOND) * meanPeriodUs;
+    uint32_t desired = static_cast<uint32_t>((1000000ULL + budgetUs - 1) / budgetUs);
+    desired = std::max<uint32_t>(1, std::min(desired, MAX_PRESCALE));
+    if (desired > current || desired * 2 < current) {
+        _running = enableChannel(desired);
+    }
+}
+
+bool IRAM_ATTR McpwmPulseCapture::onCapture(mcpwm_unit_t, mcpwm_capture_channel_id_t,
+                                            const cap_event_data_t* event, void* arg) {
+    McpwmPulseCapture* self = static_cast<McpwmPulseCapture*>(arg);
+    if (self == nullptr || event == nullptr) {
+        return false;
+    }
+    uint32_t prescale = self->_prescale;
+    if (self->_hasLastCapture) {
+        self->_edges.fetch_add(prescale, std::memory_order_relaxed);
+        uint32_t period = (event->cap_value - self->_lastCapture) / (CAPTURE_TICKS_PER_US * prescale);
+        self->_ring.push(period);
+        self->_stats.record(period, prescale);
+    }
+    self->_lastCapture = event->cap_value;
+    self->_hasLastCapture = true;
+    self->_lastEdgeMicros.store(micros(), std::memory_order_relaxed);
+    return false;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <Arduino.h>
+#include <driver/mcpwm.h>
+#include <atomic>
+
+#include "PulseCapture.h"
+
+// Legacy backend: one GPIO interrupt per rising edge, timestamped with micros().
+class GpioPulseCapture : public PulseCapture {
+  public:
+    static constexpr size_t CAPACITY = 64;
+
+    GpioPulseCapture();
+
+    bool begin(uint8_t pin) override;
+    void end() override;
+    size_t drain(uint32_t* periodsUs, size_t maxPeriods) override;
+    uint32_t lastEdgeMicros() const override;
+    uint32_t droppedPeriods() const override { return _ring.dropped(); }
+    void takeStatistics(PeriodStatistics& out) override { _stats.take(out); }
+    uint32_t edgeCount() const override { return _edges.load(std::memory_order_relaxed); }
+
+  private:
+    static void IRAM_ATTR isrHandler(void* arg);
+    void IRAM_ATTR handleEdge();
+
+    uint8_t _pin;
+    bool _running;
+    SpscPeriodRing<CAPACITY> _ring;
+    PeriodStatsBank _stats;
+    std::atomic<uint32_t> _lastEdgeMicros;
+    std::atomic<uint32_t> _edges{0};
+};
+
+// MCPWM capture backend: edges are timestamped by the 80 MHz capture timer and
+// the prescaler is adapted so at most MAX_EVENTS_PER_SECOND interrupts fire
+// regardless of the pulse rate. With a prescale of N each period is the mean
+// over N pulses. Default-constructed instances take the next of the
+// MAX_CHANNELS capture channels; begin() fails once they are used up.
+class McpwmPulseCapture : public PulseCapture {
+  public:
+    static constexpr size_t CAPACITY = 64;
+    static constexpr uint32_t MAX_EVENTS_PER_SECOND = 500;
+    static constexpr uint32_t MAX_PRESCALE = 256;
+    static constexpr uint8_t CHANNELS_PER_UNIT = 3;
+    static constexpr uint8_t MAX_CHANNELS = CHANNELS_PER_UNIT * 2;
+
+    McpwmPulseCapture();
+    McpwmPulseCapture(mcpwm_unit_t unit, mcpwm_capture_channel_id_t channel);
+
+    bool begin(uint8_t pin) override;
+    void end() override;
+    size_t drain(uint32_t* periodsUs, size_t maxPeriods) override;
+    uint32_t lastEdgeMicros() const override;
+    uint32_t droppedPeriods() const override { return _ring.dropped(); }
+    void takeStatistics(PeriodStatistics& out) override { _stats.take(out); }
+    uint32_t edgeCount() const override { return _edges.load(std::memory_order_relaxed); }
+    uint32_t edgeGranularity() const override { return _prescale; }
+    uint32_t edgeResyncs() const override { return _resyncs.load(std::memory_order_relaxed); }
+    uint32_t prescale() const { return _prescale; }
+
+  private:
+    static bool IRAM_ATTR onCapture(mcpwm_unit_t unit, mcpwm_capture_channel_id_t channel,
+                                    const cap_event_data_t* event, void* arg);
+    bool enableChannel(uint32_t prescale);
+    void adaptPrescale(const uint32_t* periodsUs, size_t count);
+
+    mcpwm_unit_t _unit;
+    mcpwm_capture_channel_id_t _channel;
+    bool _channelAssigned;
+    uint8_t _pin;
+    bool _running;
+    SpscPeriodRing<CAPACITY> _ring;
+    PeriodStatsBank _stats;
+    // Only changed while the capture channel is disabled.
+    volatile uint32_t _prescale;
+    volatile bool _hasLastCapture;
+    uint32_t _lastCapture;
+    std::atomic<uint32_t> _lastEdgeMicros;
+    // Advances by the prescale per capture that follows another capture, so
+    // it only counts edges the hardware prescaler actually bracketed.
+    std::atomic<uint32_t> _edges{0};
+    // Partial prescale groups are lost each time the channel is re-enabled.
+    std::atomic<uint32_t> _resyncs{0};
+};
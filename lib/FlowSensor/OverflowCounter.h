@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Folds a hardware counter that wraps to zero at `limit` into a monotonic
+// 64-bit total. The overflow ISR only bumps an atomic event count; the
+// reader combines it with the live counter value and never clears the
+// hardware, so no pulses are lost between read and clear. The event count is
+// sampled on both sides of the counter read and the read retried if the ISR
+// ran in between. A counter that steps backwards under an unchanged event
+// count has wrapped with its ISR still pending; that one overflow is
+// credited until the ISR catches up. Free of driver calls for host tests.
+class OverflowCounter {
+  public:
+    explicit OverflowCounter(int16_t limit = 32000) : _limit(limit > 0 ? limit : 1) {}
+
+    int16_t limit() const {
+        return _limit;
+    }
+
+    // Overflow ISR.
+    void onOverflow() {
+        _overflows.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Reader side; readCounter() returns the live hardware count in [0, limit).
+    template <typename CounterReader>
+    uint64_t read(CounterReader readCounter) {
+        uint32_t overflows = _overflows.load(std::memory_order_acquire);
+        int16_t value = 0;
+        while (true) {
+            value = readCounter();
+            uint32_t after = _overflows.load(std::memory_order_acquire);
+            if (after == overflows) {
+                break;
+            }
+            overflows = after;
+        }
+        value = value > 0 ? value : 0;
+        if (_wrapPending && overflows != _wrapOverflows) {
+            _wrapPending = false;
+        }
+        if (!_wrapPending && _hasLast && overflows == _lastOverflows && value < _lastValue) {
+            _wrapPending = true;
+            _wrapOverflows = overflows;
+        }
+        _hasLast = true;
+        _lastOverflows = overflows;
+        _lastValue = value;
+        uint64_t wraps = static_cast<uint64_t>(overflows) + (_wrapPending ? 1 : 0);
+        return wraps * static_cast<uint64_t>(_limit) + static_cast<uint64_t>(value);
+    }
+
+    // Reader side for an already sampled counter value.
+    uint64_t total(int16_t counterValue) {
+        return read([counterValue]() { return counterValue; });
+    }
+
+    // Call with the hardware counter cleared.
+    void reset() {
+        _overflows.store(0, std::memory_order_release);
+        _wrapPending = false;
+        _hasLast = false;
+    }
+
+  private:
+    int16_t _limit;
+    std::atomic<uint32_t> _overflows{0};
+    uint32_t _lastOverflows = 0;
+    uint32_t _wrapOverflows = 0;
+    int16_t _lastValue = 0;
+    bool _hasLast = false;
+    bool _wrapPending = false;
+};
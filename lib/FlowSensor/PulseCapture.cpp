@@ -0,0 +1,52 @@
+#include "PulseCapture.h"
+
+#ifdef ESP_PLATFORM
+#include <esp_attr.h>
+#endif
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+constexpr uint8_t PeriodStatistics::SUB_BINS_LOG2;
+constexpr uint8_t PeriodStatistics::MIN_OCTAVE;
+constexpr uint8_t PeriodStatistics::OCTAVES;
+constexpr size_t PeriodStatistics::BINS;
+
+size_t IRAM_ATTR PeriodStatistics::binFor(uint32_t periodUs) {
+    if (periodUs < (1u << MIN_OCTAVE)) {
+        return 0;
+    }
+    uint32_t msb = 31u - static_cast<uint32_t>(__builtin_clz(periodUs));
+    uint32_t octave = msb - MIN_OCTAVE;
+    if (octave >= OCTAVES) {
+        return BINS - 1;
+    }
+    uint32_t step = (periodUs >> (msb - SUB_BINS_LOG2)) & ((1u << SUB_BINS_LOG2) - 1);
+    return (static_cast<size_t>(octave) << SUB_BINS_LOG2) + step;
+}
+
+void IRAM_ATTR PeriodStatsBank::record(uint32_t periodUs, uint32_t pulses) {
+    _recording.store(1);
+    PeriodStatistics& bank = _banks[_active.load()];
+    if (bank.count == 0 || periodUs < bank.min) {
+        bank.min = periodUs;
+    }
+    if (bank.count == 0 || periodUs > bank.max) {
+        bank.max = periodUs;
+    }
+    uint64_t weighted = static_cast<uint64_t>(periodUs) * pulses;
+    bank.count += pulses;
+    bank.sum += weighted;
+    bank.sumSquares += weighted * periodUs;
+    bank.histogram[PeriodStatistics::binFor(periodUs)] += pulses;
+    _recording.store(0);
+}
+
+void PeriodStatsBank::take(PeriodStatistics& out) {
+    uint32_t retired = _active.load();
+    _active.store(retired ^ 1u);
+    while (_recording.load() != 0) {
+    }
+    out = _banks[retired];
+    _banks[retired].clear();
+}
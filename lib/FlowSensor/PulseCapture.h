@@ -0,0 +1,263 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Moments and a log-binned histogram of every pulse period in one snapshot
+// interval. Bins split each power-of-two octave into 2^SUB_BINS_LOG2 steps,
+// so percentile estimates are within about 1/16 of the true period.
+struct PeriodStatistics {
+    static constexpr uint8_t SUB_BINS_LOG2 = 3;
+    static constexpr uint8_t MIN_OCTAVE = 4;   // 16 us
+    static constexpr uint8_t OCTAVES = 20;     // up to ~16.7 s
+    static constexpr size_t BINS = static_cast<size_t>(OCTAVES) << SUB_BINS_LOG2;
+
+    uint32_t count = 0;
+    uint64_t sum = 0;
+    uint64_t sumSquares = 0;
+    uint32_t min = 0;
+    uint32_t max = 0;
+    std::array<uint32_t, BINS> histogram{};
+
+    static size_t binFor(uint32_t periodUs);
+
+    static uint32_t binLowerBound(size_t bin) {
+        uint32_t octave = static_cast<uint32_t>(bin >> SUB_BINS_LOG2) + MIN_OCTAVE;
+        uint32_t step = static_cast<uint32_t>(bin & ((1u << SUB_BINS_LOG2) - 1));
+        return (1u << octave) + (step << (octave - SUB_BINS_LOG2));
+    }
+
+    void clear() {
+        count = 0;
+        sum = 0;
+        sumSquares = 0;
+        min = 0;
+        max = 0;
+        histogram.fill(0);
+    }
+
+    float mean() const {
+        return count == 0 ? NAN : static_cast<float>(sum) / static_cast<float>(count);
+    }
+
+    // Population variance. sumSquares/count - mean^2 cancels to nothing in
+    // float at real periods, so the sums are first centred on the integer
+    // mean q = sum / count (remainder r): sum((x - q)^2) is small and exact in
+    // 64 bits, and variance = sum((x - q)^2) / count - (r / count)^2.
+    float variance() const {
+        if (count == 0) {
+            return NAN;
+        }
+        uint64_t q = sum / count;
+        uint64_t r = sum % count;
+        uint64_t centered = sumSquares - q * q * count - 2 * q * r;
+        float n = static_cast<float>(count);
+        float offset = static_cast<float>(r) / n;
+        float value = static_cast<float>(centered) / n - offset * offset;
+        return value > 0.0f ? value : 0.0f;
+    }
+
+    // Population standard deviation.
+    float stddev() const {
+        float value = variance();
+        return std::isnan(value) ? NAN : sqrtf(value);
+    }
+
+    float percentile(float percent) const {
+        if (count == 0) {
+            return NAN;
+        }
+        percent = percent < 0.0f ? 0.0f : (percent > 100.0f ? 100.0f : percent);
+        float rank = percent / 100.0f * static_cast<float>(count);
+        uint32_t before = 0;
+        for (size_t bin = 0; bin < BINS; ++bin) {
+            uint32_t inBin = histogram[bin];
+            if (inBin == 0 || static_cast<float>(before + inBin) < rank) {
+                before += inBin;
+                continue;
+            }
+            float lower = static_cast<float>(binLowerBound(bin));
+            float upper = static_cast<float>(binLowerBound(bin + 1));
+            float value = lower + (upper - lower) * (rank - static_cast<float>(before)) / static_cast<float>(inBin);
+            float lo = static_cast<float>(min);
+            float hi = static_cast<float>(max);
+            return value < lo ? lo : (value > hi ? hi : value);
+        }
+        return static_cast<float>(max);
+    }
+
+    float median() const {
+        return percentile(50.0f);
+    }
+};
+
+// Double-buffered PeriodStatistics: the ISR records into the active bank
+// and the consumer flips banks, waiting only for an ISR that is in flight
+// on the other core, then reads the retired bank undisturbed.
+class PeriodStatsBank {
+  public:
+    // Producer side; `pulses` > 1 when one period stands for a group of edges.
+    void record(uint32_t periodUs, uint32_t pulses = 1);
+    // Consumer side: moves everything recorded since the last call into out.
+    void take(PeriodStatistics& out);
+
+  private:
+    PeriodStatistics _banks[2];
+    std::atomic<uint32_t> _active{0};
+    std::atomic<uint32_t> _recording{0};
+};
+
+// Source of pulse-to-pulse periods for FlowSensor. PCNT stays the
+// authoritative pulse counter; a capture backend only supplies timing and is
+// drained in batches from task context. This header has no ESP-IDF
+// dependencies so host builds can drive FlowSensor timing synthetically.
+class PulseCapture {
+  public:
+    virtual ~PulseCapture() = default;
+
+    virtual bool begin(uint8_t pin) = 0;
+    virtual void end() = 0;
+    // Moves pending periods (microseconds, oldest first) into periodsUs and
+    // returns how many were written. Only the newest maxPeriods are kept.
+    virtual size_t drain(uint32_t* periodsUs, size_t maxPeriods) = 0;
+    virtual uint32_t lastEdgeMicros() const = 0;
+    // Periods lost because the consumer drained too slowly.
+    virtual uint32_t droppedPeriods() const = 0;
+    // Statistics over every period captured since the previous call.
+    virtual void takeStatistics(PeriodStatistics& out) = 0;
+    // Free-running (wrapping) count of edges seen by the capture path, for
+    // cross-checking against PCNT. Only edges between two captures are
+    // counted, so a prescaled path trails by up to edgeGranularity() - 1.
+    virtual uint32_t edgeCount() const = 0;
+    // Edges per capture event.
+    virtual uint32_t edgeGranularity() const { return 1; }
+    // Bumped whenever edges may have gone uncounted (reconfiguration).
+    virtual uint32_t edgeResyncs() const { return 0; }
+};
+
+// Lock-free single-producer/single-consumer ring of periods. The producer
+// (an ISR) only writes _head and the consumer (the snapshot task) only writes
+// _tail, so neither side masks interrupts or spins. When full, new periods are
+// dropped and counted until the consumer catches up.
+template <size_t N>
+class SpscPeriodRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscPeriodRing size must be a power of two");
+
+  public:
+    // Consumer side.
+    void clear() {
+        _tail.store(_head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    bool push(uint32_t periodUs) {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) >= N) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        _values[head & (N - 1)] = periodUs;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: moves the newest min(pending, maxValues) periods out,
+    // oldest first, and discards anything older.
+    size_t drain(uint32_t* out, size_t maxValues) {
+        uint32_t head = _head.load(std::memory_order_acquire);
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        uint32_t pending = head - tail;
+        if (pending > maxValues) {
+            tail = head - static_cast<uint32_t>(maxValues);
+            pending = static_cast<uint32_t>(maxValues);
+        }
+        for (uint32_t i = 0; i < pending; ++i) {
+            out[i] = _values[(tail + i) & (N - 1)];
+        }
+        _tail.store(head, std::memory_order_release);
+        return pending;
+    }
+
+    uint32_t dropped() const {
+        return _dropped.load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::array<uint32_t, N> _values{};
+    std::atomic<uint32_t> _head{0};
+    std::atomic<uint32_t> _tail{0};
+    std::atomic<uint32_t> _dropped{0};
+};
+
+// Host-side pulse source: periods are fed directly instead of captured.
+class SyntheticPulseCapture : public PulseCapture {
+  public:
+    static constexpr size_t CAPACITY = 64;
+
+    bool begin(uint8_t) override {
+        _ring.clear();
+        PeriodStatistics discarded;
+        _stats.take(discarded);
+        _running = true;
+        return true;
+    }
+
+    void end() override {
+        _running = false;
+    }
+
+    void feed(uint32_t periodUs) {
+        if (!_running || periodUs == 0) {
+            return;
+        }
+        _nowMicros += periodUs;
+        _edges++;
+        _ring.push(periodUs);
+        _stats.record(periodUs);
+    }
+
+    // Feeds `pulses` edges at frequencyHz with up to ±jitterPercent of
+    // deterministic pseudo-random period jitter.
+    void feedTrain(float frequencyHz, size_t pulses, float jitterPercent = 0.0f) {
+        if (frequencyHz <= 0.0f) {
+            return;
+        }
+        float nominalUs = 1000000.0f / frequencyHz;
+        for (size_t i = 0; i < pulses; ++i) {
+            _seed = _seed * 1664525u + 1013904223u;
+            float unit = static_cast<float>(_seed >> 8) / 8388608.0f - 1.0f;
+            float periodUs = nominalUs * (1.0f + unit * jitterPercent / 100.0f);
+            feed(static_cast<uint32_t>(periodUs + 0.5f));
+        }
+    }
+
+    size_t drain(uint32_t* periodsUs, size_t maxPeriods) override {
+        return _ring.drain(periodsUs, maxPeriods);
+    }
+
+    uint32_t lastEdgeMicros() const override {
+        return _nowMicros;
+    }
+
+    uint32_t droppedPeriods() const override {
+        return _ring.dropped();
+    }
+
+    void takeStatistics(PeriodStatistics& out) override {
+        _stats.take(out);
+    }
+
+    uint32_t edgeCount() const override {
+        return _edges;
+    }
+
+  private:
+    SpscPeriodRing<CAPACITY> _ring;
+    PeriodStatsBank _stats;
+    uint32_t _nowMicros = 0;
+    uint32_t _edges = 0;
+    uint32_t _seed = 1;
+    bool _running = false;
+};
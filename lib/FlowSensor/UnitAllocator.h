@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+// First-free allocation of up to 32 numbered hardware units from a bit
+// mask. Not synchronised: callers that share one allocator across tasks
+// hold their own lock. Free of driver calls for host tests.
+class UnitAllocator {
+  public:
+    constexpr explicit UnitAllocator(uint32_t units) : _units(units < 32 ? units : 32), _inUse(0) {}
+
+    // Lowest free unit, or false when all are taken.
+    bool claim(uint32_t& unit) {
+        for (uint32_t index = 0; index < _units; ++index) {
+            if ((_inUse & (1u << index)) == 0) {
+                _inUse |= 1u << index;
+                unit = index;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void release(uint32_t unit) {
+        if (unit < _units) {
+            _inUse &= ~(1u << unit);
+        }
+    }
+
+    bool inUse(uint32_t unit) const {
+        return unit < _units && (_inUse & (1u << unit)) != 0;
+    }
+
+  private:
+    uint32_t _units;
+    uint32_t _inUse;
+};
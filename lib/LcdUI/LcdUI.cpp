@@ -42,6 +42,10 @@ void LcdUI::setMetrics(const utils::SensorMetrics& metrics) {
     rebuildScrollBuffers();
 }
 
+bool LcdUI::showsStatistics() const {
+    return _state == ScreenState::Main || _state == ScreenState::LevelStats || _state == ScreenState::FlowStats;
+}
+
 void LcdUI::ensureCustomGlyphs() {
     if (_glyphsReady || !_lcd) {
         return;
@@ -650,6 +654,10 @@ void LcdUI::rebuildScrollBuffers() {
     _scroll.flowLines.push_back(String("P10 ") + utils::formatFloat(_metrics.flowMinHealthyLps, 2));
     _scroll.flowLines.push_back(String("P90 ") + utils::formatFloat(_metrics.flowBaselineLps, 2));
     _scroll.flowLines.push_back(String("d ") + utils::formatFloat(_metrics.flowDiffPercent, 1) + "%");
+    if (!isnan(_metrics.totalVolumeLiters)) {
+        _scroll.flowLines.push_back(String("Top ") + utils::formatFloat(_metrics.totalVolumeLiters / 1000.0f, 3) + "m3 +" +
+                                    utils::formatFloat(_metrics.totalVolumeUncertaintyLiters, 0) + "L");
+    }
     if (!isnan(_metrics.flowPulseCv)) {
         _scroll.flowLines.push_back(String("CV ") + utils::formatFloat(_metrics.flowPulseCv, 1) + "%");
     }
@@ -661,6 +669,10 @@ void LcdUI::rebuildScrollBuffers() {
     _scroll.tankLines.push_back(String("d ") + utils::formatFloat(_metrics.tankDiffPercent, 1) + "%");
     _scroll.tankLines.push_back(String("Noise ") + utils::formatFloat(_metrics.tankNoisePercent, 1) + "%");
     _scroll.tankLines.push_back(String("Sig ") + utils::qualitativeNoise(_metrics.tankNoisePercent));
+    for (size_t i = 1; i < _metrics.levelChannelCount && i < utils::MAX_LEVEL_CHANNELS; ++i) {
+        _scroll.tankLines.push_back(String("T") + String(static_cast<unsigned>(i)) + " " + utils::formatFloat(_metrics.channelTankHeightCm[i], 1) + "cm " +
+                                    utils::formatFloat(_metrics.channelTankNoisePercent[i], 1) + "%");
+    }
 
     _scroll.flowIndex = 0;
     _scroll.tankIndex = 0;
@@ -5,7 +5,7 @@
 #include <functional>
 #include <vector>
 
-#include <../Utils/Utils.h>
+#include <Utils.h>
 #include "../Buttons/Buttons.h"
 #include "../Joystick/Joystick.h"
 
@@ -21,6 +21,7 @@ class LcdUI {
     void setMetrics(const utils::SensorMetrics& metrics);
     void setCalibrationCallback(CalibrationCallback cb);
     void showSdCardReady();
+    bool showsStatistics() const;
 
   private:
     enum class ScreenState {
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Splits one DMA frame of scanner results by ADC channel, in conversion
+// order. Result is adc_digi_output_data_t on target; only its type1
+// channel/data fields are read, so this header stays free of ESP-IDF
+// dependencies and the split runs on host. channelIndex maps an ADC channel
+// number below channelLimit to a stream; results for other channels, or
+// beyond a stream's Capacity, are dropped. counts[s] receives the number of
+// samples written to streams[s].
+template <typename Result, size_t Streams, size_t Capacity>
+void splitAdcFrame(const Result* results, size_t resultCount, const uint8_t* channelIndex, size_t channelLimit,
+                   uint16_t (&streams)[Streams][Capacity], size_t (&counts)[Streams]) {
+    for (size_t s = 0; s < Streams; ++s) {
+        counts[s] = 0;
+    }
+    for (size_t i = 0; i < resultCount; ++i) {
+        uint8_t adcChannel = results[i].type1.channel;
+        uint8_t stream = adcChannel < channelLimit ? channelIndex[adcChannel] : Streams;
+        if (stream < Streams && counts[stream] < Capacity) {
+            streams[stream][counts[stream]++] = results[i].type1.data;
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "LevelSampleSource.h"
+
+// Raw 12-bit ADC code -> input volts, one entry per code. Built once from
+// the chip's characterisation, so the per-sample conversion is a lookup plus
+// a linear interpolation on the sample's fractional bits. A padding entry
+// past the last code keeps the interpolation branch-free. Header-only and
+// free of ESP-IDF dependencies so the conversion runs on host.
+class AdcVoltageTable {
+  public:
+    static constexpr size_t CODES = 4096;
+    static constexpr uint8_t FRACTION_BITS = LevelSampleSource::FRACTION_BITS;
+
+    AdcVoltageTable() { setLinear(3.3f); }
+
+    // Ideal ADC: code 4095 reads fullScaleVolts.
+    void setLinear(float fullScaleVolts) {
+        for (size_t code = 0; code < CODES; ++code) {
+            _volts[code] = static_cast<float>(code) * fullScaleVolts / static_cast<float>(CODES - 1);
+        }
+        _volts[CODES] = _volts[CODES - 1];
+    }
+
+    // codeToMillivolts(code) for every code, e.g. esp_adc_cal_raw_to_voltage.
+    template <typename Converter>
+    void build(Converter codeToMillivolts) {
+        for (size_t code = 0; code < CODES; ++code) {
+            _volts[code] = static_cast<float>(codeToMillivolts(static_cast<uint32_t>(code))) * 0.001f;
+        }
+        _volts[CODES] = _volts[CODES - 1];
+    }
+
+    // Sample in counts with FRACTION_BITS fractional bits; 16 bits cannot
+    // index past the padding entry.
+    float toVolts(uint16_t sample) const {
+        size_t code = sample >> FRACTION_BITS;
+        float fraction = static_cast<float>(sample & ((1u << FRACTION_BITS) - 1)) * (1.0f / (1u << FRACTION_BITS));
+        float low = _volts[code];
+        return low + (_volts[code + 1] - low) * fraction;
+    }
+
+    // Mean step between adjacent codes.
+    float voltsPerCount() const {
+        return (_volts[CODES - 1] - _volts[0]) / static_cast<float>(CODES - 1);
+    }
+
+  private:
+    std::array<float, CODES + 1> _volts;
+};
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Fixed-point decimation chain for the continuous level ADC: a third-order
+// CIC does the bulk of the rate reduction with adds only, then a 29-tap FIR
+// low-pass decimates by two more and cleans up what the CIC lets alias.
+// Outputs carry FRACTION_BITS of sub-count resolution gained by averaging.
+// Header-only and free of ESP-IDF dependencies so the kernels run on host.
+
+// Blackman-windowed sinc, cutoff 0.2 of the FIR input rate, Q15, unity DC
+// gain: -0.003 dB at 0.1, below -76 dB from 0.3 up to Nyquist.
+constexpr size_t DECIMATION_FIR_TAPS = 29;
+constexpr int16_t DECIMATION_FIR_Q15[DECIMATION_FIR_TAPS] = {
+    -3,    -8,    21,    69,    0,     -221,  -222,  345,   843,   0,
+    -1850, -1735, 2851,  9742,  13104, 9742,  2851,  -1735, -1850, 0,
+    843,   345,   -222,  -221,  0,     69,    21,    -8,    -3,
+};
+
+// Order-3 CIC decimator on unsigned 12-bit input. The registers wrap modulo
+// 2^64, which is exact while 12 + 3 * log2(R) <= 64.
+class CicDecimator {
+  public:
+    static constexpr uint8_t ORDER = 3;
+    static constexpr uint32_t MAX_DECIMATION = 1u << 17;
+    static constexpr uint8_t FRACTION_BITS = 4;
+
+    void setDecimation(uint32_t decimation) {
+        _decimation = decimation == 0 ? 1 : (decimation > MAX_DECIMATION ? MAX_DECIMATION : decimation);
+        _gain = static_cast<uint64_t>(_decimation) * _decimation * _decimation;
+        reset();
+    }
+
+    uint32_t decimation() const { return _decimation; }
+
+    // The first ORDER outputs after a reset are dropped while the
+    // integrators fill.
+    void reset() {
+        _integrators.fill(0);
+        _combDelays.fill(0);
+        _phase = 0;
+        _warmup = ORDER;
+    }
+
+    // Writes at most count / R + 1 outputs in input units with FRACTION_BITS
+    // fractional bits; returns how many.
+    size_t process(const uint16_t* in, size_t count, int32_t* out) {
+        size_t produced = 0;
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t value = in[i];
+            for (uint8_t stage = 0; stage < ORDER; ++stage) {
+                _integrators[stage] += value;
+                value = _integrators[stage];
+            }
+            if (++_phase < _decimation) {
+                continue;
+            }
+            _phase = 0;
+            for (uint8_t stage = 0; stage < ORDER; ++stage) {
+                uint64_t difference = value - _combDelays[stage];
+                _combDelays[stage] = value;
+                value = difference;
+            }
+            if (_warmup > 0) {
+                --_warmup;
+                continue;
+            }
+            uint64_t whole = value / _gain;
+            uint64_t fraction = ((value % _gain) << FRACTION_BITS) + _gain / 2;
+            out[produced++] = static_cast<int32_t>((whole << FRACTION_BITS) + fraction / _gain);
+        }
+        return produced;
+    }
+
+  private:
+    std::array<uint64_t, ORDER> _integrators{};
+    std::array<uint64_t, ORDER> _combDelays{};
+    uint32_t _decimation = 1;
+    uint32_t _phase = 0;
+    uint64_t _gain = 1;
+    uint8_t _warmup = ORDER;
+};
+
+// Symmetric Q15 FIR that keeps every second output. The history is stored
+// twice so each output reads one contiguous window without wrapping.
+class FirDecimator {
+  public:
+    static constexpr uint32_t DECIMATION = 2;
+
+    // The first input after a reset fills the whole history, so the filter
+    // starts settled instead of ramping up from zero.
+    void reset() {
+        _primed = false;
+        _index = 0;
+        _phase = 0;
+    }
+
+    // Writes at most count / DECIMATION + 1 outputs; returns how many.
+    size_t process(const int32_t* in, size_t count, int32_t* out) {
+        constexpr size_t center = DECIMATION_FIR_TAPS / 2;
+        size_t produced = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (!_primed) {
+                _history.fill(in[i]);
+                _primed = true;
+            }
+            _index = (_index == 0 ? DECIMATION_FIR_TAPS : _index) - 1;
+            _history[_index] = in[i];
+            _history[_index + DECIMATION_FIR_TAPS] = in[i];
+            if (++_phase < DECIMATION) {
+                continue;
+            }
+            _phase = 0;
+            const int32_t* window = &_history[_index];
+            int64_t acc = static_cast<int64_t>(DECIMATION_FIR_Q15[center]) * window[center];
+            for (size_t tap = 0; tap < center; ++tap) {
+                acc += static_cast<int64_t>(DECIMATION_FIR_Q15[tap]) *
+                       (window[tap] + window[DECIMATION_FIR_TAPS - 1 - tap]);
+            }
+            out[produced++] = static_cast<int32_t>((acc + (1 << 14)) >> 15);
+        }
+        return produced;
+    }
+
+  private:
+    std::array<int32_t, 2 * DECIMATION_FIR_TAPS> _history{};
+    size_t _index = 0;
+    uint32_t _phase = 0;
+    bool _primed = false;
+};
+
+// CIC followed by the FIR, processed in blocks of up to BLOCK input samples.
+class DecimationChain {
+  public:
+    static constexpr size_t BLOCK = 128;
+    static constexpr uint8_t FRACTION_BITS = CicDecimator::FRACTION_BITS;
+
+    DecimationChain() { configure(FirDecimator::DECIMATION); }
+
+    // Overall input-to-output rate ratio; restarts the filters when it changes.
+    void configure(uint32_t decimation) {
+        uint32_t cicDecimation = std::max<uint32_t>(1, decimation / FirDecimator::DECIMATION);
+        if (cicDecimation == _cic.decimation() && _configured) {
+            return;
+        }
+        _cic.setDecimation(cicDecimation);
+        _fir.reset();
+        _configured = true;
+    }
+
+    uint32_t decimation() const { return _cic.decimation() * FirDecimator::DECIMATION; }
+
+    // Raw 12-bit counts in, counts with FRACTION_BITS fractional bits out.
+    // out must hold count / 2 + 1 values; returns how many were written.
+    size_t process(const uint16_t* in, size_t count, uint16_t* out) {
+        size_t produced = 0;
+        while (count > 0) {
+            size_t chunk = count < BLOCK ? count : BLOCK;
+            size_t cicCount = _cic.process(in, chunk, _cicOut.data());
+            size_t firCount = _fir.process(_cicOut.data(), cicCount, _firOut.data());
+            for (size_t i = 0; i < firCount; ++i) {
+                out[produced++] = static_cast<uint16_t>(std::max<int32_t>(0, std::min<int32_t>(UINT16_MAX, _firOut[i])));
+            }
+            in += chunk;
+            count -= chunk;
+        }
+        return produced;
+    }
+
+  private:
+    CicDecimator _cic;
+    FirDecimator _fir;
+    std::array<int32_t, BLOCK> _cicOut{};
+    std::array<int32_t, BLOCK / FirDecimator::DECIMATION + 1> _firOut{};
+    bool _configured = false;
+};
@@ -0,0 +1,199 @@
+#include "HardwareSampleSource.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+constexpr uint32_t DRAIN_TASK_STACK = 3072;
+constexpr UBaseType_t DRAIN_TASK_PRIORITY = 4;
+constexpr uint32_t READ_TIMEOUT_MS = 100;
+// The ESP32 digital controller needs a conversion limit in single-unit mode.
+constexpr uint32_t CONVERSION_LIMIT = 250;
+}
+
+constexpr uint32_t PollingSampleSource::SAMPLE_SPACING_US;
+constexpr size_t ContinuousAdcScanner::MAX_CHANNELS;
+constexpr size_t ContinuousAdcScanner::CAPACITY;
+constexpr uint32_t ContinuousAdcScanner::MIN_SAMPLE_RATE_HZ;
+constexpr uint32_t ContinuousAdcScanner::MAX_SAMPLE_RATE_HZ;
+constexpr uint32_t ContinuousAdcScanner::FRAME_BYTES;
+constexpr uint32_t ContinuousAdcScanner::STORE_BUFFER_BYTES;
+constexpr size_t ContinuousAdcScanner::FRAME_RESULTS;
+
+PollingSampleSource::PollingSampleSource() : _pin(0), _samplesPerReading(10) {}
+
+bool PollingSampleSource::begin(uint8_t pin) {
+    _pin = pin;
+    return true;
+}
+
+void PollingSampleSource::configure(size_t samplesPerReading, uint32_t) {
+    _samplesPerReading = samplesPerReading;
+}
+
+size_t PollingSampleSource::read(uint16_t* out, size_t maxSamples) {
+    size_t count = std::min(_samplesPerReading, maxSamples);
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = static_cast<uint16_t>(analogRead(_pin) << FRACTION_BITS);
+        delayMicroseconds(SAMPLE_SPACING_US);
+    }
+    return count;
+}
+
+bool ContinuousAdcScanner::Channel::begin(uint8_t) {
+    return _scanner != nullptr && _scanner->running();
+}
+
+void ContinuousAdcScanner::Channel::configure(size_t samplesPerReading, uint32_t intervalMs) {
+    if (samplesPerReading == 0) {
+        samplesPerReading = 1;
+    }
+    uint32_t rateHz = _scanner != nullptr ? _scanner->channelSampleRateHz() : MIN_SAMPLE_RATE_HZ;
+    uint64_t conversions = static_cast<uint64_t>(rateHz) * intervalMs / 1000;
+    uint64_t decimation = std::max<uint64_t>(FirDecimator::DECIMATION, conversions / samplesPerReading);
+    _decimation.store(static_cast<uint32_t>(std::min<uint64_t>(decimation, UINT32_MAX)), std::memory_order_relaxed);
+}
+
+size_t ContinuousAdcScanner::Channel::read(uint16_t* out, size_t maxSamples) {
+    return _ring.drain(out, maxSamples);
+}
+
+ContinuousAdcScanner::ContinuousAdcScanner(uint32_t sampleRateHz, adc_atten_t attenuation)
+    : _sampleRateHz(MIN_SAMPLE_RATE_HZ),
+      _attenuation(attenuation),
+      _running(false),
+      _task(nullptr),
+      _channelCount(0),
+      _frame{},
+      _conversions{},
+      _decimated{} {
+    std::fill(std::begin(_channelIndex), std::end(_channelIndex), static_cast<uint8_t>(MAX_CHANNELS));
+    setSampleRateHz(sampleRateHz);
+}
+
+void ContinuousAdcScanner::setSampleRateHz(uint32_t sampleRateHz) {
+    _sampleRateHz = std::max(MIN_SAMPLE_RATE_HZ, std::min(sampleRateHz, MAX_SAMPLE_RATE_HZ));
+}
+
+uint32_t ContinuousAdcScanner::channelSampleRateHz() const {
+    return _channelCount > 1 ? _sampleRateHz / _channelCount : _sampleRateHz;
+}
+
+ContinuousAdcScanner::Channel* ContinuousAdcScanner::addChannel(uint8_t pin) {
+    // Only ADC1 is wired to the digital controller on the ESP32.
+    int8_t adcChannel = digitalPinToAnalogChannel(pin);
+    if (_running || adcChannel < 0 || adcChannel >= ADC1_CHANNEL_MAX) {
+        return nullptr;
+    }
+    uint8_t index = _channelIndex[adcChannel];
+    if (index < _channelCount) {
+        return &_channels[index];
+    }
+    if (_channelCount >= MAX_CHANNELS) {
+        return nullptr;
+    }
+    Channel& channel = _channels[_channelCount];
+    channel._scanner = this;
+    channel._pin = pin;
+    channel._adcChannel = static_cast<uint8_t>(adcChannel);
+    _channelIndex[adcChannel] = static_cast<uint8_t>(_channelCount);
+    ++_channelCount;
+    return &channel;
+}
+
+bool ContinuousAdcScanner::begin() {
+    if (_running) {
+        end();
+    }
+    if (_channelCount == 0) {
+        return false;
+    }
+
+    adc_digi_init_config_t initConfig = {};
+    initConfig.max_store_buf_size = STORE_BUFFER_BYTES;
+    initConfig.conv_num_each_intr = FRAME_BYTES;
+    initConfig.adc2_chan_mask = 0;
+    adc_digi_pattern_config_t patterns[MAX_CHANNELS] = {};
+    for (size_t i = 0; i < _channelCount; ++i) {
+        initConfig.adc1_chan_mask |= BIT(_channels[i]._adcChannel);
+        patterns[i].atten = static_cast<uint8_t>(_attenuation);
+        patterns[i].channel = _channels[i]._adcChannel;
+        patterns[i].unit = 0;  // ADC1
+        patterns[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+    }
+    if (adc_digi_initialize(&initConfig) != ESP_OK) {
+        return false;
+    }
+
+    adc_digi_configuration_t config = {};
+    config.conv_limit_en = true;
+    config.conv_limit_num = CONVERSION_LIMIT;
+    config.pattern_num = static_cast<uint32_t>(_channelCount);
+    config.adc_pattern = patterns;
+    config.sample_freq_hz = _sampleRateHz;
+    config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+    config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+    if (adc_digi_controller_configure(&config) != ESP_OK || adc_digi_start() != ESP_OK) {
+        adc_digi_deinitialize();
+        return false;
+    }
+
+    for (size_t i = 0; i < _channelCount; ++i) {
+        Channel& channel = _channels[i];
+        channel._decimator = DecimationChain();
+        channel._decimator.configure(channel._decimation.load(std::memory_order_relaxed));
+        channel._ring.clear();
+    }
+    _running = true;
+    TaskHandle_t task = nullptr;
+    if (xTaskCreatePinnedToCore(ContinuousAdcScanner::drainTask, "adc_drain", DRAIN_TASK_STACK, this,
+                                DRAIN_TASK_PRIORITY, &task, 0) != pdPASS) {
+        _running = false;
+        adc_digi_stop();
+        adc_digi_deinitialize();
+        return false;
+    }
+    _task = task;
+    return true;
+}
+
+void ContinuousAdcScanner::end() {
+    if (!_running) {
+        return;
+    }
+    _running = false;
+    while (_task != nullptr) {
+        vTaskDelay(1);
+    }
+    adc_digi_stop();
+    adc_digi_deinitialize();
+}
+
+void ContinuousAdcScanner::drainTask(void* arg) {
+    ContinuousAdcScanner* self = static_cast<ContinuousAdcScanner*>(arg);
+    self->drainFrames();
+    self->_task = nullptr;
+    vTaskDelete(nullptr);
+}
+
+void ContinuousAdcScanner::drainFrames() {
+    while (_running) {
+        uint32_t length = 0;
+        esp_err_t err = adc_digi_read_bytes(_frame, FRAME_BYTES, &length, READ_TIMEOUT_MS);
+        // INVALID_STATE reports a driver buffer overrun; the frame is still valid.
+        if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+            continue;
+        }
+        size_t counts[MAX_CHANNELS];
+        splitAdcFrame(reinterpret_cast<const adc_digi_output_data_t*>(_frame), length / SOC_ADC_DIGI_RESULT_BYTES,
+                      _channelIndex, ADC1_CHANNEL_MAX, _conversions, counts);
+        for (size_t c = 0; c < _channelCount; ++c) {
+            Channel& channel = _channels[c];
+            channel._decimator.configure(channel._decimation.load(std::memory_order_relaxed));
+            size_t produced = channel._decimator.process(_conversions[c], counts[c], _decimated);
+            for (size_t i = 0; i < produced; ++i) {
+                channel._ring.push(_decimated[i]);
+            }
+        }
+    }
+}
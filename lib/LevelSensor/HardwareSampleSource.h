@@ -0,0 +1,105 @@
+#pragma once
+
+#include <Arduino.h>
+#include <driver/adc.h>
+#include <atomic>
+
+#include "AdcFrameSplitter.h"
+#include "DecimationFilter.h"
+#include "LevelSampleSource.h"
+
+// Legacy backend: a blocking burst of analogRead() calls inside read().
+class PollingSampleSource : public LevelSampleSource {
+  public:
+    static constexpr uint32_t SAMPLE_SPACING_US = 200;
+
+    PollingSampleSource();
+
+    bool begin(uint8_t pin) override;
+    void end() override {}
+    void configure(size_t samplesPerReading, uint32_t intervalMs) override;
+    size_t read(uint16_t* out, size_t maxSamples) override;
+
+  private:
+    uint8_t _pin;
+    size_t _samplesPerReading;
+};
+
+// ADC1 continuous (DMA) scanner: the digital controller converts every
+// added channel round-robin from one pattern table at sampleRateHz in total,
+// and a drain task splits each DMA frame by channel and runs each stream
+// through its own CIC/FIR DecimationChain into that channel's ring. The
+// samples of every reading are therefore band-limited and spread evenly
+// across the sensor interval, for all channels at once, instead of aliasing
+// slosh and pump vibration. The ESP32 has one digital controller, so only
+// one scanner may run, and analogRead() must not be used on ADC1 while it
+// does.
+class ContinuousAdcScanner {
+  public:
+    static constexpr size_t MAX_CHANNELS = 4;
+    static constexpr size_t CAPACITY = 256;
+    static constexpr uint32_t MIN_SAMPLE_RATE_HZ = 20000;
+    static constexpr uint32_t MAX_SAMPLE_RATE_HZ = 200000;
+
+    // One scanned pin, read by a LevelSensor like any other sample source.
+    // The pin is bound by addChannel(), so begin() only reports whether the
+    // scanner is running; starting and stopping is the scanner's job.
+    class Channel : public LevelSampleSource {
+      public:
+        bool begin(uint8_t pin) override;
+        void end() override {}
+        void configure(size_t samplesPerReading, uint32_t intervalMs) override;
+        size_t read(uint16_t* out, size_t maxSamples) override;
+        uint32_t droppedSamples() const { return _ring.dropped(); }
+
+      private:
+        friend class ContinuousAdcScanner;
+
+        ContinuousAdcScanner* _scanner = nullptr;
+        uint8_t _pin = 0;
+        uint8_t _adcChannel = 0;
+        // Written by configure(), applied by the drain task between frames.
+        std::atomic<uint32_t> _decimation{FirDecimator::DECIMATION};
+        DecimationChain _decimator;
+        SampleRing<CAPACITY> _ring;
+    };
+
+    explicit ContinuousAdcScanner(uint32_t sampleRateHz = MIN_SAMPLE_RATE_HZ,
+                                  adc_atten_t attenuation = ADC_ATTEN_DB_11);
+
+    // Total conversion rate across all channels; takes effect on the next
+    // begin().
+    void setSampleRateHz(uint32_t sampleRateHz);
+    uint32_t sampleRateHz() const { return _sampleRateHz; }
+    uint32_t channelSampleRateHz() const;
+
+    // Adds pin to the scan (before begin()); nullptr if it is not on ADC1 or
+    // all channels are taken. Adding a pin twice returns the same channel.
+    Channel* addChannel(uint8_t pin);
+    size_t channelCount() const { return _channelCount; }
+    Channel& channel(size_t index) { return _channels[index]; }
+
+    bool begin();
+    void end();
+    bool running() const { return _running; }
+
+  private:
+    static constexpr uint32_t FRAME_BYTES = 256;
+    static constexpr uint32_t STORE_BUFFER_BYTES = 4096;
+    static constexpr size_t FRAME_RESULTS = FRAME_BYTES / SOC_ADC_DIGI_RESULT_BYTES;
+
+    static void drainTask(void* arg);
+    void drainFrames();
+
+    uint32_t _sampleRateHz;
+    adc_atten_t _attenuation;
+    volatile bool _running;
+    volatile TaskHandle_t _task;
+    Channel _channels[MAX_CHANNELS];
+    size_t _channelCount;
+    // ADC1 channel number -> index into _channels, or MAX_CHANNELS.
+    uint8_t _channelIndex[ADC1_CHANNEL_MAX];
+    alignas(adc_digi_output_data_t) uint8_t _frame[FRAME_BYTES];
+    uint16_t _conversions[MAX_CHANNELS][FRAME_RESULTS];
+    uint16_t _decimated[FRAME_RESULTS / FirDecimator::DECIMATION + 1];
+};
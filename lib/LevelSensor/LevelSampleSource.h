@@ -0,0 +1,125 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Source of level ADC samples for LevelSensor, as 12-bit counts with
+// FRACTION_BITS fractional bits (decimating backends resolve below one count,
+// polling ones just shift). Each sample() call reduces whatever the source
+// gathered since the previous call, so continuous backends acquire in the
+// background and the sensor task never blocks on the ADC. This header has no
+// ESP-IDF dependencies so host builds can drive the reduction with synthetic
+// samples.
+class LevelSampleSource {
+  public:
+    static constexpr uint8_t FRACTION_BITS = 4;
+
+    virtual ~LevelSampleSource() = default;
+
+    virtual bool begin(uint8_t pin) = 0;
+    virtual void end() = 0;
+    // Samples wanted per reading and the spacing of readings; continuous
+    // backends spread that many samples across the interval.
+    virtual void configure(size_t samplesPerReading, uint32_t intervalMs) = 0;
+    // Moves samples gathered since the previous call into out, oldest first,
+    // keeping only the newest maxSamples. Returns how many were written.
+    virtual size_t read(uint16_t* out, size_t maxSamples) = 0;
+};
+
+// Lock-free single-producer/single-consumer ring of samples. When full, new
+// samples are dropped until the consumer catches up.
+template <size_t N>
+class SampleRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SampleRing size must be a power of two");
+
+  public:
+    // Consumer side.
+    void clear() {
+        _tail.store(_head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    bool push(uint16_t value) {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) >= N) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        _values[head & (N - 1)] = value;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: moves the newest min(pending, maxValues) samples out,
+    // oldest first, and discards anything older.
+    size_t drain(uint16_t* out, size_t maxValues) {
+        uint32_t head = _head.load(std::memory_order_acquire);
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        uint32_t pending = head - tail;
+        if (pending > maxValues) {
+            tail = head - static_cast<uint32_t>(maxValues);
+            pending = static_cast<uint32_t>(maxValues);
+        }
+        for (uint32_t i = 0; i < pending; ++i) {
+            out[i] = _values[(tail + i) & (N - 1)];
+        }
+        _tail.store(head, std::memory_order_release);
+        return pending;
+    }
+
+    uint32_t dropped() const {
+        return _dropped.load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::array<uint16_t, N> _values{};
+    std::atomic<uint32_t> _head{0};
+    std::atomic<uint32_t> _tail{0};
+    std::atomic<uint32_t> _dropped{0};
+};
+
+// Host-side sample source: raw counts are fed directly instead of converted.
+class SyntheticSampleSource : public LevelSampleSource {
+  public:
+    static constexpr size_t CAPACITY = 256;
+
+    bool begin(uint8_t) override {
+        _ring.clear();
+        _running = true;
+        return true;
+    }
+
+    void end() override {
+        _running = false;
+    }
+
+    void configure(size_t, uint32_t) override {}
+
+    void feed(uint16_t sample) {
+        if (_running) {
+            _ring.push(sample);
+        }
+    }
+
+    // Feeds `count` whole-count samples around `center` with up to
+    // ±amplitude counts of deterministic pseudo-random noise.
+    void feedNoise(uint16_t center, uint16_t amplitude, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            _seed = _seed * 1664525u + 1013904223u;
+            int32_t offset = static_cast<int32_t>(_seed >> 16) % (2 * amplitude + 1) - amplitude;
+            int32_t value = static_cast<int32_t>(center) + offset;
+            value = value < 0 ? 0 : (value > 4095 ? 4095 : value);
+            feed(static_cast<uint16_t>(value << FRACTION_BITS));
+        }
+    }
+
+    size_t read(uint16_t* out, size_t maxSamples) override {
+        return _ring.drain(out, maxSamples);
+    }
+
+  private:
+    SampleRing<CAPACITY> _ring;
+    uint32_t _seed = 1;
+    bool _running = false;
+};
@@ -1,17 +1,49 @@
 #include "LevelSensor.h"
 
+#include <esp_adc_cal.h>
 #include <algorithm>
-#include <numeric>
-#include <vector>
+
+#include "SampleReduction.h"
 
 namespace {
-constexpr float ADC_MAX_VALUE = 4095.0f;
-constexpr float ADC_REFERENCE_VOLTAGE = 3.3f;
+// Used by esp_adc_cal only when the eFuse holds no reference calibration.
+constexpr uint32_t DEFAULT_VREF_MV = 1100;
+// Smoothing of the per-reading variance that drives adaptive oversampling.
+constexpr float NOISE_VARIANCE_ALPHA = 0.3f;
+
+// One table per attenuation, characterised on first use and shared by every
+// sensor (scanned channels all read ADC1).
+const AdcVoltageTable* characterizedVoltageTable(adc_attenuation_t attenuation) {
+    static AdcVoltageTable* tables[ADC_ATTEN_MAX] = {};
+    size_t index = std::min<size_t>(static_cast<size_t>(attenuation), ADC_ATTEN_MAX - 1);
+    if (tables[index] == nullptr) {
+        esp_adc_cal_characteristics_t characteristics;
+        esp_adc_cal_value_t source = esp_adc_cal_characterize(ADC_UNIT_1, static_cast<adc_atten_t>(index), ADC_WIDTH_BIT_12,
+                                                              DEFAULT_VREF_MV, &characteristics);
+        AdcVoltageTable* table = new AdcVoltageTable();
+        table->build([&characteristics](uint32_t code) { return esp_adc_cal_raw_to_voltage(code, &characteristics); });
+        tables[index] = table;
+        Serial.print("Level ADC characterised from ");
+        Serial.println(source == ESP_ADC_CAL_VAL_EFUSE_TP     ? "eFuse two-point"
+                       : source == ESP_ADC_CAL_VAL_EFUSE_VREF ? "eFuse Vref"
+                                                              : "default Vref");
+    }
+    return tables[index];
 }
+}
+
+constexpr uint8_t LevelSensor::MAX_OVERSAMPLE;
 
 LevelSensor::LevelSensor()
     : _pin(0),
+      _source(&_polling),
+      _voltageTable(nullptr),
       _oversampleCount(10),
+      _maxOversample(10),
+      _minOversample(3),
+      _adaptiveOversample(false),
+      _targetStandardErrorMm(1.0f),
+      _noiseVarianceMm2(NAN),
       _emaAlpha(0.2f),
       _ema(NAN),
       _zeroVoltage(0.48f),
@@ -25,19 +57,53 @@ LevelSensor::LevelSensor()
       _senseGain(1.0f),
       _alphaGain(0.4f),
       _betaGain(0.02f),
+      _milliAmpsPerVolt(0.0f),
+      _millimetersPerVolt(0.0f),
+      _depthOffsetMm(0.0f),
+      _maxDepthMm(0.0f),
       _filteredDepthMm(NAN),
       _velocityMmPerSec(0.0f),
-      _sampleIntervalSec(1.0f) {}
+      _innovationMm(NAN),
+      _useKalman(false),
+      _sampleIntervalSec(1.0f),
+      _rawSamples{},
+      _voltages{} {
+    updateConversion();
+}
 
-void LevelSensor::begin(uint8_t pin, adc_attenuation_t attenuation) {
+void LevelSensor::begin(uint8_t pin, adc_attenuation_t attenuation, LevelSampleSource* source) {
     _pin = pin;
     analogSetPinAttenuation(_pin, attenuation);
     analogSetWidth(12);
     pinMode(_pin, INPUT);
+    _voltageTable = characterizedVoltageTable(attenuation);
+
+    _source = (source != nullptr) ? source : &_polling;
+    if (!_source->begin(_pin)) {
+        Serial.println("Level sample source unavailable, polling ADC");
+        _source = &_polling;
+        _source->begin(_pin);
+    }
+    configureSource();
 }
 
 void LevelSensor::setOversample(uint8_t count) {
-    _oversampleCount = std::max<uint8_t>(3, count);
+    _maxOversample = std::max<uint8_t>(3, std::min<uint8_t>(MAX_OVERSAMPLE, count));
+    _minOversample = std::min(_minOversample, _maxOversample);
+    if (!_adaptiveOversample || _oversampleCount > _maxOversample) {
+        _oversampleCount = _maxOversample;
+    }
+    configureSource();
+}
+
+void LevelSensor::setAdaptiveOversample(bool enabled, uint8_t minCount, float targetStandardErrorMm) {
+    _adaptiveOversample = enabled;
+    _minOversample = std::max<uint8_t>(3, std::min(minCount, _maxOversample));
+    _targetStandardErrorMm = std::max(0.01f, targetStandardErrorMm);
+    if (!enabled) {
+        _oversampleCount = _maxOversample;
+        _noiseVarianceMm2 = NAN;
+    }
 }
 
 void LevelSensor::setEmaAlpha(float alpha) {
@@ -54,11 +120,13 @@ void LevelSensor::setCalibrationCurrent(float zeroCurrentMa, float fullCurrentMa
     _zeroCurrentMa = zeroCurrentMa;
     _fullCurrentMa = fullCurrentMa;
     _fullScaleHeightMm = fullScaleHeightMm;
+    updateConversion();
 }
 
 void LevelSensor::setCurrentSense(float resistorOhms, float gain) {
     _senseResistorOhms = std::max(1.0f, resistorOhms);
     _senseGain = std::max(0.1f, gain);
+    updateConversion();
 }
 
 void LevelSensor::setFilterGains(float alphaGain, float betaGain) {
@@ -66,25 +134,77 @@ void LevelSensor::setFilterGains(float alphaGain, float betaGain) {
     _betaGain = utils::clampValue(betaGain, 0.001f, 1.0f);
 }
 
+void LevelSensor::setKalmanFilter(bool enabled) {
+    if (enabled != _useKalman) {
+        _useKalman = enabled;
+        // Reseeded from the shared depth/velocity on the next reading.
+        _kalman.reset();
+    }
+}
+
 void LevelSensor::setSampleIntervalMs(uint32_t intervalMs) {
     if (intervalMs < 50) {
         intervalMs = 50;
     }
     _sampleIntervalSec = static_cast<float>(intervalMs) / 1000.0f;
+    configureSource();
+}
+
+// Continuous sources are sized for the ceiling so each sample's spread does
+// not depend on the adaptive count; read() then keeps only the newest ones.
+void LevelSensor::configureSource() {
+    _source->configure(_maxOversample, static_cast<uint32_t>(_sampleIntervalSec * 1000.0f + 0.5f));
 }
 
 void LevelSensor::setDensityFactor(float densityFactor) {
     _densityFactor = densityFactor;
+    updateConversion();
+}
+
+utils::LevelFilterState LevelSensor::filterState() const {
+    utils::LevelFilterState state;
+    state.emaVoltage = _ema;
+    state.filteredDepthMm = _filteredDepthMm;
+    state.velocityMmPerSec = _velocityMmPerSec;
+    return state;
 }
 
-float LevelSensor::rawToVoltage(uint16_t raw) const {
-    return (static_cast<float>(raw) / ADC_MAX_VALUE) * ADC_REFERENCE_VOLTAGE;
+void LevelSensor::restoreFilterState(const utils::LevelFilterState& state) {
+    _ema = state.emaVoltage;
+    _filteredDepthMm = state.filteredDepthMm;
+    _velocityMmPerSec = isnan(state.velocityMmPerSec) ? 0.0f : state.velocityMmPerSec;
+    _kalman.reset();
 }
 
-float LevelSensor::computeCurrentMilliAmps(float voltage) const {
+// Folds shunt, current span, full-scale height and density into one affine
+// step; an empty current span maps everything to zero depth.
+void LevelSensor::updateConversion() {
     float effectiveGain = (_senseGain <= 0.0f) ? 1.0f : _senseGain;
     float resistor = (_senseResistorOhms <= 0.0f) ? 1.0f : _senseResistorOhms;
-    return (voltage / (resistor * effectiveGain)) * 1000.0f;
+    _milliAmpsPerVolt = 1000.0f / (resistor * effectiveGain);
+    float spanMa = _fullCurrentMa - _zeroCurrentMa;
+    if (spanMa <= 0.1f) {
+        _millimetersPerVolt = 0.0f;
+        _depthOffsetMm = 0.0f;
+        _maxDepthMm = 0.0f;
+        return;
+    }
+    float density = (_densityFactor <= 0.0f) ? 1.0f : _densityFactor;
+    _maxDepthMm = _fullScaleHeightMm / density;
+    _millimetersPerVolt = _milliAmpsPerVolt / spanMa * _maxDepthMm;
+    _depthOffsetMm = -_zeroCurrentMa / spanMa * _maxDepthMm;
+}
+
+void LevelSensor::adaptOversample(float standardDeviationVolts) {
+    float sigmaMm = standardDeviationVolts * _millimetersPerVolt;
+    float varianceMm2 = sigmaMm * sigmaMm;
+    if (isnan(_noiseVarianceMm2)) {
+        _noiseVarianceMm2 = varianceMm2;
+    } else {
+        _noiseVarianceMm2 += NOISE_VARIANCE_ALPHA * (varianceMm2 - _noiseVarianceMm2);
+    }
+    _oversampleCount = static_cast<uint8_t>(oversampleForStandardError(sqrtf(_noiseVarianceMm2), _targetStandardErrorMm,
+                                                                       _minOversample, _maxOversample));
 }
 
 float LevelSensor::applyAlphaBetaFilter(float depthMm) {
@@ -96,9 +216,11 @@ float LevelSensor::applyAlphaBetaFilter(float depthMm) {
     if (isnan(_filteredDepthMm)) {
         _filteredDepthMm = depth;
         _velocityMmPerSec = 0.0f;
+        _innovationMm = 0.0f;
     } else {
         float prediction = _filteredDepthMm + _velocityMmPerSec * dt;
         float residual = depth - prediction;
+        _innovationMm = residual;
         _filteredDepthMm = prediction + _alphaGain * residual;
         _velocityMmPerSec = _velocityMmPerSec + (_betaGain * residual) / dt;
     }
@@ -109,62 +231,58 @@ float LevelSensor::applyAlphaBetaFilter(float depthMm) {
     return _filteredDepthMm;
 }
 
-utils::LevelReading LevelSensor::sample() {
-    std::vector<uint16_t> samples;
-    samples.reserve(_oversampleCount);
-
-    for (uint8_t i = 0; i < _oversampleCount; ++i) {
-        samples.push_back(analogRead(_pin));
-        delayMicroseconds(200);
+float LevelSensor::applyKalmanFilter(float depthMm, float measurementVarianceMm2) {
+    if (!_kalman.initialized() && !isnan(_filteredDepthMm)) {
+        _kalman.restore(_filteredDepthMm, _velocityMmPerSec, measurementVarianceMm2);
     }
-
-    std::vector<float> voltages;
-    voltages.reserve(samples.size());
-    for (auto raw : samples) {
-        voltages.push_back(rawToVoltage(raw));
+    float dt = (_sampleIntervalSec <= 0.0f) ? 1.0f : _sampleIntervalSec;
+    _kalman.update(depthMm, measurementVarianceMm2, dt);
+    if (_kalman.depthMm() < 0.0f) {
+        _kalman.clampToZero();
     }
+    _filteredDepthMm = _kalman.depthMm();
+    _velocityMmPerSec = _kalman.velocityMmPerSec();
+    _innovationMm = _kalman.innovationMm();
+    return _filteredDepthMm;
+}
+
+utils::LevelReading LevelSensor::sample() {
+    size_t count = _source->read(_rawSamples.data(), _oversampleCount);
 
     utils::LevelReading reading;
-    if (voltages.empty()) {
+    if (count == 0 || _voltageTable == nullptr) {
+        // Nothing arrived since the last reading (DMA error, decimation
+        // restart): report no measurement rather than an empty tank, and
+        // leave the filters untouched.
+        reading.voltage = NAN;
+        reading.averageVoltage = NAN;
+        reading.medianVoltage = NAN;
+        reading.trimmedMeanVoltage = NAN;
+        reading.emaVoltage = _ema;
+        reading.heightCm = NAN;
+        reading.rawHeightCm = NAN;
+        reading.filteredHeightCm = NAN;
+        reading.depthMillimeters = NAN;
+        reading.currentMilliAmps = NAN;
+        reading.alphaBetaVelocity = _velocityMmPerSec;
+        reading.standardDeviation = NAN;
+        reading.noisePercent = NAN;
         return reading;
     }
-
-    float sum = 0.0f;
-    for (float v : voltages) {
-        sum += v;
+    for (size_t i = 0; i < count; ++i) {
+        _voltages[i] = _voltageTable->toVolts(_rawSamples[i]);
     }
-    reading.averageVoltage = sum / voltages.size();
 
-    std::vector<float> sorted = voltages;
-    std::sort(sorted.begin(), sorted.end());
-    if (!sorted.empty()) {
-        if (sorted.size() % 2 == 0) {
-            reading.medianVoltage = (sorted[sorted.size() / 2 - 1] + sorted[sorted.size() / 2]) / 2.0f;
-        } else {
-            reading.medianVoltage = sorted[sorted.size() / 2];
-        }
+    SampleSummary summary = reduceSamples(_voltages.data(), count);
+    reading.averageVoltage = summary.mean;
+    reading.medianVoltage = summary.median;
+    reading.trimmedMeanVoltage = summary.trimmedMean;
+    reading.standardDeviation = summary.standardDeviation;
+    reading.sampleCount = static_cast<uint8_t>(count);
+    if (_adaptiveOversample) {
+        adaptOversample(summary.standardDeviation);
     }
-
-    size_t trimCount = std::max<size_t>(1, sorted.size() / 10);
-    float trimmedMean = 0.0f;
-    if (sorted.size() > 2 * trimCount) {
-        float trimmedSum = 0.0f;
-        for (size_t i = trimCount; i < sorted.size() - trimCount; ++i) {
-            trimmedSum += sorted[i];
-        }
-        trimmedMean = trimmedSum / static_cast<float>(sorted.size() - 2 * trimCount);
-    } else {
-        trimmedMean = reading.averageVoltage;
-    }
-    reading.trimmedMeanVoltage = trimmedMean;
-
-    float variance = 0.0f;
-    for (float v : voltages) {
-        float diff = v - reading.averageVoltage;
-        variance += diff * diff;
-    }
-    variance /= voltages.size();
-    reading.standardDeviation = sqrtf(variance);
+    float trimmedMean = summary.trimmedMean;
 
     if (isnan(_ema)) {
         _ema = reading.averageVoltage;
@@ -172,27 +290,27 @@ utils::LevelReading LevelSensor::sample() {
         _ema = _emaAlpha * reading.averageVoltage + (1.0f - _emaAlpha) * _ema;
     }
 
-    reading.voltage = voltages.back();
+    reading.voltage = summary.last;
     reading.emaVoltage = _ema;
     float referenceVoltage = reading.trimmedMeanVoltage > 0.0f ? reading.trimmedMeanVoltage : reading.averageVoltage;
     reading.noisePercent = (referenceVoltage > 0.0f) ? (reading.standardDeviation / referenceVoltage) * 100.0f : 0.0f;
 
-    float currentMa = computeCurrentMilliAmps(trimmedMean);
-    reading.currentMilliAmps = currentMa;
-
-    float spanMa = _fullCurrentMa - _zeroCurrentMa;
-    float normalizedCurrent = 0.0f;
-    if (spanMa > 0.1f) {
-        normalizedCurrent = (currentMa - _zeroCurrentMa) / spanMa;
-    }
-    normalizedCurrent = utils::clampValue(normalizedCurrent, 0.0f, 1.0f);
-    float depthMm = normalizedCurrent * _fullScaleHeightMm;
-    float density = (_densityFactor <= 0.0f) ? 1.0f : _densityFactor;
-    if (density > 0.0f) {
-        depthMm /= density;
-    }
+    reading.currentMilliAmps = trimmedMean * _milliAmpsPerVolt;
+    float depthMm = utils::clampValue(trimmedMean * _millimetersPerVolt + _depthOffsetMm, 0.0f, _maxDepthMm);
     reading.depthMillimeters = depthMm;
-    float filteredMm = applyAlphaBetaFilter(depthMm);
+    float filteredMm = NAN;
+    if (_useKalman) {
+        // Squared standard error of the mean, floored at one count's
+        // quantisation noise.
+        float sigmaMm = reading.standardDeviation * _millimetersPerVolt;
+        float countMm = _millimetersPerVolt * _voltageTable->voltsPerCount();
+        float varianceMm2 = std::max(sigmaMm * sigmaMm / static_cast<float>(count), countMm * countMm / 12.0f);
+        filteredMm = applyKalmanFilter(depthMm, varianceMm2);
+        reading.depthVarianceMm2 = _kalman.depthVarianceMm2();
+    } else {
+        filteredMm = applyAlphaBetaFilter(depthMm);
+    }
+    reading.innovationMm = _innovationMm;
     reading.filteredHeightCm = isnan(filteredMm) ? NAN : (filteredMm / 10.0f);
     reading.rawHeightCm = depthMm / 10.0f;
     reading.heightCm = isnan(reading.filteredHeightCm) ? reading.rawHeightCm : reading.filteredHeightCm;
@@ -2,32 +2,62 @@
 
 #include <Arduino.h>
 #include <driver/adc.h>
-#include <../Utils/Utils.h>
+#include <array>
+#include <Utils.h>
+#include "AdcVoltageTable.h"
+#include "HardwareSampleSource.h"
+#include "LevelSampleSource.h"
 
+// Samples come from a LevelSampleSource; without one (or if it fails to
+// start) LevelSensor falls back to a blocking analogRead() burst. Samples are
+// converted through the ADC's characterised voltage table, and the current,
+// depth and density scaling is folded into one affine volts-to-millimetres
+// step that is only recomputed when the calibration changes.
 class LevelSensor {
   public:
+    static constexpr uint8_t MAX_OVERSAMPLE = 64;
+
     LevelSensor();
 
-    void begin(uint8_t pin, adc_attenuation_t attenuation = ADC_11db);
+    void begin(uint8_t pin, adc_attenuation_t attenuation = ADC_11db, LevelSampleSource* source = nullptr);
+    // Fixed sample count, or the ceiling when adaptive oversampling is on.
     void setOversample(uint8_t count);
+    // Picks each reading's sample count so the trimmed mean's standard error
+    // stays under targetStandardErrorMm, from the smoothed sample spread.
+    void setAdaptiveOversample(bool enabled, uint8_t minCount, float targetStandardErrorMm);
     void setEmaAlpha(float alpha);
     void setCalibration(float zeroVoltage, float fullScaleVoltage, float fullScaleHeightCm);
     void setCalibrationCurrent(float zeroCurrentMa, float fullCurrentMa, float fullScaleHeightMm);
     void setCurrentSense(float resistorOhms, float gain = 1.0f);
     void setFilterGains(float alphaGain, float betaGain);
+    // Adaptive Kalman tracker instead of the fixed-gain alpha-beta filter.
+    void setKalmanFilter(bool enabled);
+    bool kalmanFilter() const { return _useKalman; }
     void setSampleIntervalMs(uint32_t intervalMs);
     void setDensityFactor(float densityFactor);
     float densityFactor() const { return _densityFactor; }
 
     utils::LevelReading sample();
+    utils::LevelFilterState filterState() const;
+    void restoreFilterState(const utils::LevelFilterState& state);
 
   private:
-    float rawToVoltage(uint16_t raw) const;
-    float computeCurrentMilliAmps(float voltage) const;
+    void updateConversion();
     float applyAlphaBetaFilter(float depthMm);
+    float applyKalmanFilter(float depthMm, float measurementVarianceMm2);
+    void adaptOversample(float standardDeviationVolts);
+    void configureSource();
 
     uint8_t _pin;
+    PollingSampleSource _polling;
+    LevelSampleSource* _source;
+    const AdcVoltageTable* _voltageTable;
     uint8_t _oversampleCount;
+    uint8_t _maxOversample;
+    uint8_t _minOversample;
+    bool _adaptiveOversample;
+    float _targetStandardErrorMm;
+    float _noiseVarianceMm2;
     float _emaAlpha;
     float _ema;
     float _zeroVoltage;
@@ -41,8 +71,19 @@ class LevelSensor {
     float _senseGain;
     float _alphaGain;
     float _betaGain;
+    // depthMm = clamp(volts * _millimetersPerVolt + _depthOffsetMm, 0, _maxDepthMm)
+    float _milliAmpsPerVolt;
+    float _millimetersPerVolt;
+    float _depthOffsetMm;
+    float _maxDepthMm;
     float _filteredDepthMm;
     float _velocityMmPerSec;
+    float _innovationMm;
+    bool _useKalman;
+    utils::LevelKalmanFilter _kalman;
     float _sampleIntervalSec;
+    // Per-reading scratch buffers, so sample() never touches the heap.
+    std::array<uint16_t, MAX_OVERSAMPLE> _rawSamples;
+    std::array<float, MAX_OVERSAMPLE> _voltages;
 };
 
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+// Statistics of one batch of level samples (volts).
+struct SampleSummary {
+    size_t count = 0;
+    float last = NAN;
+    float mean = NAN;
+    float median = NAN;
+    // Mean with the lowest and highest 10% (at least one each) removed.
+    float trimmedMean = NAN;
+    // Population standard deviation.
+    float standardDeviation = NAN;
+};
+
+// Single pass for mean/variance (Welford), then selection instead of a full
+// sort for the trim bounds and median. values is used as scratch space and is
+// left reordered; nothing is allocated.
+inline SampleSummary reduceSamples(float* values, size_t count) {
+    SampleSummary summary;
+    if (count == 0) {
+        return summary;
+    }
+    summary.count = count;
+    summary.last = values[count - 1];
+
+    float mean = 0.0f;
+    float m2 = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        float delta = values[i] - mean;
+        mean += delta / static_cast<float>(i + 1);
+        m2 += delta * (values[i] - mean);
+    }
+    summary.mean = mean;
+    summary.standardDeviation = sqrtf(std::max(0.0f, m2) / static_cast<float>(count));
+
+    // Partition so [lo, hi) holds the untrimmed middle, then select the
+    // median inside it.
+    size_t trimCount = std::max<size_t>(1, count / 10);
+    bool trimmed = count > 2 * trimCount;
+    size_t lo = trimmed ? trimCount : 0;
+    size_t hi = trimmed ? count - trimCount : count;
+    if (trimmed) {
+        std::nth_element(values, values + lo, values + count);
+        if (hi - 1 > lo) {
+            std::nth_element(values + lo + 1, values + hi - 1, values + count);
+        }
+    }
+    size_t middle = count / 2;
+    std::nth_element(values + lo, values + middle, values + hi);
+    summary.median = values[middle];
+    if (count % 2 == 0) {
+        summary.median = (*std::max_element(values + lo, values + middle) + summary.median) / 2.0f;
+    }
+
+    if (trimmed) {
+        float trimmedSum = 0.0f;
+        for (size_t i = lo; i < hi; ++i) {
+            trimmedSum += values[i];
+        }
+        summary.trimmedMean = trimmedSum / static_cast<float>(hi - lo);
+    } else {
+        summary.trimmedMean = summary.mean;
+    }
+    return summary;
+}
+
+// Smallest sample count whose standard error sigma/sqrt(n) stays within
+// targetError, clamped to [minCount, maxCount].
+inline size_t oversampleForStandardError(float sigma, float targetError, size_t minCount, size_t maxCount) {
+    if (std::isnan(sigma) || !(targetError > 0.0f)) {
+        return maxCount;
+    }
+    float ratio = sigma / targetError;
+    float needed = ceilf(ratio * ratio);
+    if (needed >= static_cast<float>(maxCount)) {
+        return maxCount;
+    }
+    return std::max(minCount, static_cast<size_t>(needed));
+}
@@ -97,12 +97,41 @@ void SdLogger::ensureDailyLog(time_t timestamp) {
 
 void SdLogger::writeCsvHeader(File& file) {
     file.print(F("timestamp,iso8601,pulses,flow_lps,flow_baseline_lps,flow_diff_pct,flow_min_healthy_lps,flow_mean_lps,flow_median_lps,flow_std_lps,flow_min_lps,flow_max_lps,"));
+    file.print(F("flow_p25_lps,flow_p75_lps,flow_p99_lps,flow_long_baseline_lps,flow_long_min_healthy_lps,flow_1h_mean_lps,flow_24h_mean_lps,"));
     file.print(F("flow_pulse_mean_us,flow_pulse_median_us,flow_pulse_std_us,flow_pulse_cv,flow_period_count"));
     for (size_t i = 0; i < utils::MAX_FLOW_PERIOD_SAMPLES; ++i) {
         file.print(F(",flow_period_us_"));
         file.print(i);
     }
-    file.println(F(",tank_height_cm,tank_empty_cm,tank_full_cm,tank_diff_pct,tank_noise_pct,tank_mean_cm,tank_median_cm,tank_std_cm,tank_min_cm,tank_max_cm,level_voltage_inst,level_voltage_avg,level_voltage_median,level_voltage_trimmed,level_voltage_std,level_voltage_ema,level_current_ma,level_depth_mm,level_height_raw_cm,level_height_filtered_cm,level_velocity_mm_s,density_factor"));
+    file.print(F(",flow_interval_periods"));
+    for (size_t i = 0; i < utils::MAX_FLOW_CHANNELS; ++i) {
+        file.print(F(",flow_ch"));
+        file.print(i);
+        file.print(F("_pulses,flow_ch"));
+        file.print(i);
+        file.print(F("_lps"));
+    }
+    file.print(F(",flow_isr_edges,flow_edge_delta,flow_edge_delta_total,flow_glitch_rejects,flow_missed_edges"));
+    file.print(F(",total_pulses,total_volume_l,total_volume_unc_l"));
+    file.print(F(",tank_height_cm,tank_empty_cm,tank_full_cm,tank_diff_pct,tank_noise_pct,tank_mean_cm,tank_median_cm,tank_std_cm,tank_min_cm,tank_max_cm,tank_24h_min_cm,tank_24h_max_cm,level_voltage_inst,level_voltage_avg,level_voltage_median,level_voltage_trimmed,level_voltage_std,level_voltage_ema,level_current_ma,level_depth_mm,level_height_raw_cm,level_height_filtered_cm,level_velocity_mm_s,level_est_var_mm2,level_innovation_mm,level_samples,density_factor"));
+    for (size_t i = 0; i < utils::MAX_LEVEL_CHANNELS; ++i) {
+        file.print(F(",level_ch"));
+        file.print(i);
+        file.print(F("_height_cm,level_ch"));
+        file.print(i);
+        file.print(F("_current_ma,level_ch"));
+        file.print(i);
+        file.print(F("_noise_pct,level_ch"));
+        file.print(i);
+        file.print(F("_mean_cm,level_ch"));
+        file.print(i);
+        file.print(F("_std_cm,level_ch"));
+        file.print(i);
+        file.print(F("_empty_cm,level_ch"));
+        file.print(i);
+        file.print(F("_full_cm"));
+    }
+    file.println();
 }
 
 void SdLogger::writeLogLine(File& file, const utils::SensorMetrics& metrics) {
@@ -134,6 +163,20 @@ void SdLogger::writeLogLine(File& file, const utils::SensorMetrics& metrics) {
     file.print(',');
     file.print(metrics.flowMaxLps, 4);
     file.print(',');
+    file.print(metrics.flowP25Lps, 4);
+    file.print(',');
+    file.print(metrics.flowP75Lps, 4);
+    file.print(',');
+    file.print(metrics.flowP99Lps, 4);
+    file.print(',');
+    file.print(metrics.flowLongBaselineLps, 4);
+    file.print(',');
+    file.print(metrics.flowLongMinHealthyLps, 4);
+    file.print(',');
+    file.print(metrics.flowHourMeanLps, 4);
+    file.print(',');
+    file.print(metrics.flowDayMeanLps, 4);
+    file.print(',');
     file.print(metrics.flowPulseMeanUs, 3);
     file.print(',');
     file.print(metrics.flowPulseMedianUs, 3);
@@ -145,11 +188,39 @@ void SdLogger::writeLogLine(File& file, const utils::SensorMetrics& metrics) {
     file.print(static_cast<uint32_t>(metrics.flowPeriodCount));
     for (size_t i = 0; i < utils::MAX_FLOW_PERIOD_SAMPLES; ++i) {
         file.print(',');
-        if (i < metrics.flowPeriodCount) {
+        if (metrics.flowRecentPeriods[i] != 0) {
             file.print(metrics.flowRecentPeriods[i]);
         }
     }
     file.print(',');
+    file.print(metrics.flowIntervalPeriods);
+    for (size_t i = 0; i < utils::MAX_FLOW_CHANNELS; ++i) {
+        file.print(',');
+        if (i < metrics.flowChannelCount) {
+            file.print(metrics.channelPulseCount[i]);
+        }
+        file.print(',');
+        if (i < metrics.flowChannelCount) {
+            file.print(metrics.channelFlowLps[i], 4);
+        }
+    }
+    file.print(',');
+    file.print(metrics.flowCaptureEdges);
+    file.print(',');
+    file.print(static_cast<long>(metrics.flowEdgeDelta));
+    file.print(',');
+    file.print(static_cast<long long>(metrics.flowEdgeDeltaTotal));
+    file.print(',');
+    file.print(static_cast<unsigned long long>(metrics.flowGlitchRejects));
+    file.print(',');
+    file.print(static_cast<unsigned long long>(metrics.flowMissedEdges));
+    file.print(',');
+    file.print(static_cast<unsigned long long>(metrics.totalPulses));
+    file.print(',');
+    file.print(metrics.totalVolumeLiters, 3);
+    file.print(',');
+    file.print(metrics.totalVolumeUncertaintyLiters, 3);
+    file.print(',');
     file.print(metrics.tankHeightCm, 3);
     file.print(',');
     file.print(metrics.tankEmptyEstimateCm, 3);
@@ -170,6 +241,10 @@ void SdLogger::writeLogLine(File& file, const utils::SensorMetrics& metrics) {
     file.print(',');
     file.print(metrics.tankMaxObservedCm, 3);
     file.print(',');
+    file.print(metrics.tankDayMinCm, 3);
+    file.print(',');
+    file.print(metrics.tankDayMaxCm, 3);
+    file.print(',');
     file.print(metrics.levelVoltage, 4);
     file.print(',');
     file.print(metrics.levelAverageVoltage, 4);
@@ -192,7 +267,34 @@ void SdLogger::writeLogLine(File& file, const utils::SensorMetrics& metrics) {
     file.print(',');
     file.print(metrics.levelAlphaBetaVelocity, 3);
     file.print(',');
-    file.println(metrics.densityFactor, 3);
+    file.print(metrics.levelEstimateVarianceMm2, 4);
+    file.print(',');
+    file.print(metrics.levelInnovationMm, 3);
+    file.print(',');
+    file.print(metrics.levelSampleCount);
+    file.print(',');
+    file.print(metrics.densityFactor, 3);
+    for (size_t i = 0; i < utils::MAX_LEVEL_CHANNELS; ++i) {
+        if (i >= metrics.levelChannelCount) {
+            file.print(F(",,,,,,,"));
+            continue;
+        }
+        file.print(',');
+        file.print(metrics.channelTankHeightCm[i], 3);
+        file.print(',');
+        file.print(metrics.channelLevelCurrentMa[i], 3);
+        file.print(',');
+        file.print(metrics.channelTankNoisePercent[i], 2);
+        file.print(',');
+        file.print(metrics.channelTankMeanCm[i], 3);
+        file.print(',');
+        file.print(metrics.channelTankStdDevCm[i], 3);
+        file.print(',');
+        file.print(metrics.channelTankEmptyEstimateCm[i], 3);
+        file.print(',');
+        file.print(metrics.channelTankFullEstimateCm[i], 3);
+    }
+    file.println();
 }
 
 void SdLogger::ensureFreeSpace() {
@@ -6,7 +6,7 @@
 #include <deque>
 #include <functional>
 
-#include <../Utils/Utils.h>
+#include <Utils.h>
 
 class ConfigService;
 
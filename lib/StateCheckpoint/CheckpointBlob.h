@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+
+#include <Utils.h>
+
+// When a checkpoint may be saved or restored. Free of NVS and clock calls
+// so the rules run on host.
+struct CheckpointPolicy {
+    static constexpr time_t MIN_VALID_EPOCH = 1577836800;  // 2020-01-01
+
+    enum class Restore { Wait, Load, Drop };
+
+    static bool clockValid(time_t now) { return now >= MIN_VALID_EPOCH; }
+
+    static bool saveDue(uint32_t nowMs, uint32_t lastSaveMs, uint32_t intervalMs) {
+        return nowMs - lastSaveMs >= intervalMs;
+    }
+
+    // A saved state is only loaded while uptime is within windowMs; until the
+    // wall clock is valid its age cannot be judged, so it waits.
+    static Restore restore(time_t now, uint32_t uptimeMs, uint32_t windowMs) {
+        if (uptimeMs > windowMs) {
+            return Restore::Drop;
+        }
+        return clockValid(now) ? Restore::Load : Restore::Wait;
+    }
+};
+
+// NVS layout of a checkpoint. A blob is accepted only if its version, size
+// and CRC match and it was saved no later than now and at most maxAgeSeconds
+// before it.
+template <typename Snapshot>
+struct CheckpointBlob {
+    enum class Status { Ok, WrongVersion, WrongSize, Corrupt, FromFuture, Expired };
+
+    uint16_t version;
+    uint16_t size;
+    uint32_t savedAt;
+    Snapshot snapshot;
+    uint32_t crc;
+
+    void seal(uint16_t blobVersion, time_t now, const Snapshot& state) {
+        version = blobVersion;
+        size = sizeof(CheckpointBlob);
+        savedAt = static_cast<uint32_t>(now);
+        snapshot = state;
+        crc = computeCrc();
+    }
+
+    uint32_t computeCrc() const { return utils::crc32(this, offsetof(CheckpointBlob, crc)); }
+
+    Status check(uint16_t expectedVersion, time_t now, uint32_t maxAgeSeconds) const {
+        if (version != expectedVersion) {
+            return Status::WrongVersion;
+        }
+        if (size != sizeof(CheckpointBlob)) {
+            return Status::WrongSize;
+        }
+        if (crc != computeCrc()) {
+            return Status::Corrupt;
+        }
+        if (static_cast<time_t>(savedAt) > now) {
+            return Status::FromFuture;
+        }
+        if (now - static_cast<time_t>(savedAt) > static_cast<time_t>(maxAgeSeconds)) {
+            return Status::Expired;
+        }
+        return Status::Ok;
+    }
+};
@@ -0,0 +1,67 @@
+#include "StateCheckpoint.h"
+
+namespace {
+constexpr const char* CHECKPOINT_KEY = "ckpt";
+}
+
+constexpr uint32_t StateCheckpoint::DEFAULT_SAVE_INTERVAL_MS;
+constexpr uint32_t StateCheckpoint::DEFAULT_MAX_AGE_S;
+constexpr uint16_t StateCheckpoint::BLOB_VERSION;
+
+bool StateCheckpoint::begin() {
+    if (_prefs.begin("wfstate", false)) {
+        _prefsInitialized = true;
+        _lastSaveMs = millis();
+    }
+    return _prefsInitialized;
+}
+
+void StateCheckpoint::end() {
+    if (_prefsInitialized) {
+        _prefs.end();
+        _prefsInitialized = false;
+    }
+}
+
+bool StateCheckpoint::clockValid(time_t now) {
+    return CheckpointPolicy::clockValid(now);
+}
+
+bool StateCheckpoint::load(Snapshot& snapshot, time_t now) {
+    if (!_prefsInitialized || !clockValid(now)) {
+        return false;
+    }
+    Blob blob;
+    if (_prefs.getBytesLength(CHECKPOINT_KEY) != sizeof(Blob) ||
+        _prefs.getBytes(CHECKPOINT_KEY, &blob, sizeof(Blob)) != sizeof(Blob)) {
+        return false;
+    }
+    if (blob.check(BLOB_VERSION, now, _maxAgeSeconds) != Blob::Status::Ok) {
+        return false;
+    }
+    snapshot = blob.snapshot;
+    return true;
+}
+
+bool StateCheckpoint::save(const Snapshot& snapshot, time_t now) {
+    if (!_prefsInitialized || !clockValid(now)) {
+        return false;
+    }
+    Blob blob{};
+    blob.seal(BLOB_VERSION, now, snapshot);
+    if (_prefs.putBytes(CHECKPOINT_KEY, &blob, sizeof(Blob)) != sizeof(Blob)) {
+        return false;
+    }
+    _lastSaveMs = millis();
+    return true;
+}
+
+bool StateCheckpoint::saveDue(uint32_t nowMs) const {
+    return _prefsInitialized && CheckpointPolicy::saveDue(nowMs, _lastSaveMs, _saveIntervalMs);
+}
+
+void StateCheckpoint::clear() {
+    if (_prefsInitialized) {
+        _prefs.remove(CHECKPOINT_KEY);
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+#include <Utils.h>
+#include "CheckpointBlob.h"
+
+// Persists a compact snapshot of analytics and filter state in NVS so a
+// reboot does not discard hours of baseline history.
+class StateCheckpoint {
+  public:
+    struct Snapshot {
+        utils::FlowAnalytics::State flow;
+        utils::LevelAnalytics::State level;
+        utils::LevelFilterState levelFilter;
+    };
+
+    static constexpr uint32_t DEFAULT_SAVE_INTERVAL_MS = 15UL * 60UL * 1000UL;
+    static constexpr uint32_t DEFAULT_MAX_AGE_S = 6UL * 3600UL;
+
+    bool begin();
+    void end();
+
+    void setSaveIntervalMs(uint32_t intervalMs) { _saveIntervalMs = intervalMs; }
+    void setMaxAgeSeconds(uint32_t seconds) { _maxAgeSeconds = seconds; }
+
+    // Loads the stored snapshot if it is intact and younger than the max age.
+    bool load(Snapshot& snapshot, time_t now);
+    bool save(const Snapshot& snapshot, time_t now);
+    bool saveDue(uint32_t nowMs) const;
+    void clear();
+
+    static bool clockValid(time_t now);
+
+  private:
+    static constexpr uint16_t BLOB_VERSION = 1;
+
+    using Blob = CheckpointBlob<Snapshot>;
+
+    Preferences _prefs;
+    bool _prefsInitialized = false;
+    uint32_t _lastSaveMs = 0;
+    uint32_t _saveIntervalMs = DEFAULT_SAVE_INTERVAL_MS;
+    uint32_t _maxAgeSeconds = DEFAULT_MAX_AGE_S;
+};
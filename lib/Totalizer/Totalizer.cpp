@@ -0,0 +1,123 @@
+#include "Totalizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+constexpr uint8_t Totalizer::SLOT_COUNT;
+constexpr uint32_t Totalizer::DEFAULT_COMMIT_PULSES;
+constexpr uint32_t Totalizer::DEFAULT_MIN_COMMIT_INTERVAL_MS;
+constexpr uint32_t Totalizer::DEFAULT_MAX_COMMIT_INTERVAL_MS;
+
+bool Totalizer::begin() {
+    if (_prefs.begin("wftotal", false)) {
+        _prefsInitialized = true;
+        recover();
+    }
+    _lastCommitMs = millis();
+    _lastAddMs = _lastCommitMs;
+    return _prefsInitialized;
+}
+
+void Totalizer::end() {
+    if (_prefsInitialized) {
+        _prefs.end();
+        _prefsInitialized = false;
+    }
+}
+
+void Totalizer::setCommitPolicy(uint32_t commitPulses, uint32_t minIntervalMs, uint32_t maxIntervalMs) {
+    _commitPulses = std::max<uint32_t>(1, commitPulses);
+    _minCommitIntervalMs = minIntervalMs;
+    _maxCommitIntervalMs = std::max(minIntervalMs, maxIntervalMs);
+}
+
+void Totalizer::addPulses(uint64_t pulses, uint32_t nowMs) {
+    uint32_t elapsedMs = nowMs - _lastAddMs;
+    _lastAddMs = nowMs;
+    if (pulses == 0) {
+        return;
+    }
+    _totalPulses += pulses;
+    if (elapsedMs > 0) {
+        float rate = static_cast<float>(pulses) * 1000.0f / static_cast<float>(elapsedMs);
+        _peakPulsesPerSecond = std::max(_peakPulsesPerSecond, rate);
+    }
+}
+
+bool Totalizer::update(uint32_t nowMs) {
+    uint64_t pending = _totalPulses - _committedPulses;
+    if (pending == 0) {
+        return false;
+    }
+    uint32_t sinceCommit = nowMs - _lastCommitMs;
+    bool due = (pending >= _commitPulses && sinceCommit >= _minCommitIntervalMs) || sinceCommit >= _maxCommitIntervalMs;
+    return due && commit(nowMs);
+}
+
+bool Totalizer::commit(uint32_t nowMs) {
+    if (!_prefsInitialized) {
+        return false;
+    }
+    TotalizerRecord record{};
+    record.sequence = _sequence + 1;
+    record.lossBoundPulses = lossBoundPulses();
+    record.totalPulses = _totalPulses;
+    record.uncertaintyPulses = _uncertaintyPulses;
+    record.seal();
+
+    char key[8];
+    slotKey(TotalizerRecord::slotFor(record.sequence), key, sizeof(key));
+    if (_prefs.putBytes(key, &record, sizeof(TotalizerRecord)) != sizeof(TotalizerRecord)) {
+        return false;
+    }
+    _sequence = record.sequence;
+    _committedPulses = record.totalPulses;
+    _lastCommitMs = nowMs;
+    return true;
+}
+
+float Totalizer::totalLiters(float pulsesPerLiter) const {
+    return pulsesPerLiter > 0.0f ? static_cast<float>(_totalPulses) / pulsesPerLiter : NAN;
+}
+
+float Totalizer::uncertaintyLiters(float pulsesPerLiter) const {
+    return pulsesPerLiter > 0.0f ? static_cast<float>(_uncertaintyPulses) / pulsesPerLiter : NAN;
+}
+
+// Upper bound on pulses that can accumulate without a commit, assuming the
+// flow never exceeds the peak rate seen so far.
+uint32_t Totalizer::lossBoundPulses() const {
+    float byRate = _peakPulsesPerSecond * static_cast<float>(_minCommitIntervalMs) / 1000.0f;
+    float bound = static_cast<float>(_commitPulses) + byRate;
+    if (_peakPulsesPerSecond * static_cast<float>(_maxCommitIntervalMs) / 1000.0f < bound) {
+        bound = _peakPulsesPerSecond * static_cast<float>(_maxCommitIntervalMs) / 1000.0f;
+    }
+    return bound >= 4294967295.0f ? 0xFFFFFFFFu : static_cast<uint32_t>(ceilf(bound));
+}
+
+void Totalizer::recover() {
+    TotalizerRecordSelector selector;
+    for (uint8_t slot = 0; slot < SLOT_COUNT; ++slot) {
+        char key[8];
+        slotKey(slot, key, sizeof(key));
+        TotalizerRecord record;
+        if (_prefs.getBytesLength(key) != sizeof(TotalizerRecord) ||
+            _prefs.getBytes(key, &record, sizeof(TotalizerRecord)) != sizeof(TotalizerRecord)) {
+            continue;
+        }
+        selector.offer(record);
+    }
+    if (!selector.found()) {
+        return;
+    }
+    const TotalizerRecord& best = selector.newest();
+    _recovered = true;
+    _sequence = best.sequence;
+    _totalPulses = best.totalPulses;
+    _committedPulses = best.totalPulses;
+    _uncertaintyPulses = best.uncertaintyPulses + best.lossBoundPulses;
+}
+
+void Totalizer::slotKey(uint8_t slot, char* key, size_t size) {
+    snprintf(key, size, "tot%u", static_cast<unsigned>(slot));
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+#include "TotalizerRecord.h"
+
+// Cumulative pulse totalizer persisted to NVS. Records rotate over
+// SLOT_COUNT keys so a torn write never destroys the last good total, and
+// commits are rate-limited to bound flash wear. After a reset the total
+// resumes from the newest record and the pulses that may have been counted
+// after it are carried as an uncertainty bound.
+class Totalizer {
+  public:
+    static constexpr uint8_t SLOT_COUNT = TotalizerRecord::SLOT_COUNT;
+    static constexpr uint32_t DEFAULT_COMMIT_PULSES = 1200;
+    static constexpr uint32_t DEFAULT_MIN_COMMIT_INTERVAL_MS = 60UL * 1000UL;
+    static constexpr uint32_t DEFAULT_MAX_COMMIT_INTERVAL_MS = 15UL * 60UL * 1000UL;
+
+    bool begin();
+    void end();
+
+    // Commit once commitPulses are pending (but at most every minIntervalMs),
+    // or after maxIntervalMs whenever anything is pending.
+    void setCommitPolicy(uint32_t commitPulses, uint32_t minIntervalMs, uint32_t maxIntervalMs);
+
+    void addPulses(uint64_t pulses, uint32_t nowMs);
+    bool update(uint32_t nowMs);
+    bool commit(uint32_t nowMs);
+
+    uint64_t totalPulses() const { return _totalPulses; }
+    uint64_t uncertaintyPulses() const { return _uncertaintyPulses; }
+    float totalLiters(float pulsesPerLiter) const;
+    float uncertaintyLiters(float pulsesPerLiter) const;
+    bool recovered() const { return _recovered; }
+
+  private:
+    static void slotKey(uint8_t slot, char* key, size_t size);
+    uint32_t lossBoundPulses() const;
+    void recover();
+
+    Preferences _prefs;
+    bool _prefsInitialized = false;
+    bool _recovered = false;
+    uint32_t _sequence = 0;
+    uint64_t _totalPulses = 0;
+    uint64_t _committedPulses = 0;
+    uint64_t _uncertaintyPulses = 0;
+    uint32_t _lastCommitMs = 0;
+    uint32_t _lastAddMs = 0;
+    float _peakPulsesPerSecond = 0.0f;
+    uint32_t _commitPulses = DEFAULT_COMMIT_PULSES;
+    uint32_t _minCommitIntervalMs = DEFAULT_MIN_COMMIT_INTERVAL_MS;
+    uint32_t _maxCommitIntervalMs = DEFAULT_MAX_COMMIT_INTERVAL_MS;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <Utils.h>
+
+// One NVS record of the totalizer. Records rotate over SLOT_COUNT keys by
+// sequence number; recovery keeps the newest record whose CRC matches.
+// Header-only and free of NVS calls so rotation and recovery run on host.
+struct TotalizerRecord {
+    static constexpr uint8_t SLOT_COUNT = 8;
+
+    uint32_t sequence;
+    uint32_t lossBoundPulses;
+    uint64_t totalPulses;
+    uint64_t uncertaintyPulses;
+    uint32_t reserved;
+    uint32_t crc;
+
+    // 2^32 is a multiple of SLOT_COUNT, so rotation stays in step across a
+    // sequence wrap.
+    static uint8_t slotFor(uint32_t sequence) { return static_cast<uint8_t>(sequence % SLOT_COUNT); }
+
+    // Serial-number comparison: live records are at most SLOT_COUNT apart.
+    static bool newer(uint32_t sequence, uint32_t than) { return static_cast<int32_t>(sequence - than) > 0; }
+
+    uint32_t computeCrc() const { return utils::crc32(this, offsetof(TotalizerRecord, crc)); }
+    void seal() { crc = computeCrc(); }
+    bool intact() const { return crc == computeCrc(); }
+};
+
+// Picks the newest intact record among those offered, one per slot.
+class TotalizerRecordSelector {
+  public:
+    void offer(const TotalizerRecord& record) {
+        if (!record.intact()) {
+            return;
+        }
+        if (!_found || TotalizerRecord::newer(record.sequence, _newest.sequence)) {
+            _newest = record;
+            _found = true;
+        }
+    }
+
+    bool found() const { return _found; }
+    const TotalizerRecord& newest() const { return _newest; }
+
+  private:
+    TotalizerRecord _newest{};
+    bool _found = false;
+};
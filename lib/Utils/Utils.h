@@ -12,6 +12,8 @@ namespace utils {
 
 constexpr float EPSILON = 1e-6f;
 constexpr size_t MAX_FLOW_PERIOD_SAMPLES = 16;
+constexpr size_t MAX_FLOW_CHANNELS = 8;
+constexpr size_t MAX_LEVEL_CHANNELS = 4;
 
 template <typename T>
 T clampValue(T value, T low, T high) {
@@ -39,12 +41,33 @@ struct SensorMetrics {
     float flowStdDevLps = NAN;
     float flowMaxLps = NAN;
     float flowMinLps = NAN;
+    float flowP25Lps = NAN;
+    float flowP75Lps = NAN;
+    float flowP99Lps = NAN;
+    float flowLongBaselineLps = NAN;
+    float flowLongMinHealthyLps = NAN;
+    float flowHourMeanLps = NAN;
+    float flowDayMeanLps = NAN;
     float flowPulseMeanUs = NAN;
     float flowPulseMedianUs = NAN;
     float flowPulseStdUs = NAN;
     float flowPulseCv = NAN;
     std::array<uint32_t, MAX_FLOW_PERIOD_SAMPLES> flowRecentPeriods{};
+    // Periods in the recent history, and every period captured this interval.
     size_t flowPeriodCount = 0;
+    uint32_t flowIntervalPeriods = 0;
+    // Per-meter flow; channel 0 is the primary meter behind the fields above.
+    uint8_t flowChannelCount = 0;
+    std::array<uint32_t, MAX_FLOW_CHANNELS> channelPulseCount{};
+    std::array<float, MAX_FLOW_CHANNELS> channelFlowLps{};
+    uint32_t flowCaptureEdges = 0;
+    int32_t flowEdgeDelta = 0;
+    int64_t flowEdgeDeltaTotal = 0;
+    uint64_t flowGlitchRejects = 0;
+    uint64_t flowMissedEdges = 0;
+    uint64_t totalPulses = 0;
+    float totalVolumeLiters = NAN;
+    float totalVolumeUncertaintyLiters = NAN;
 
     float tankHeightCm = 0.0f;
     float tankEmptyEstimateCm = NAN;
@@ -56,6 +79,8 @@ struct SensorMetrics {
     float tankStdDevCm = NAN;
     float tankMinObservedCm = NAN;
     float tankMaxObservedCm = NAN;
+    float tankDayMinCm = NAN;
+    float tankDayMaxCm = NAN;
 
     float levelVoltage = NAN;
     float levelAverageVoltage = NAN;
@@ -68,7 +93,19 @@ struct SensorMetrics {
     float levelRawHeightCm = NAN;
     float levelFilteredHeightCm = NAN;
     float levelAlphaBetaVelocity = NAN;
+    uint8_t levelSampleCount = 0;
+    float levelEstimateVarianceMm2 = NAN;
+    float levelInnovationMm = NAN;
     float densityFactor = 1.0f;
+    // Per-transducer level; channel 0 is the primary tank behind the fields above.
+    uint8_t levelChannelCount = 0;
+    std::array<float, MAX_LEVEL_CHANNELS> channelTankHeightCm{};
+    std::array<float, MAX_LEVEL_CHANNELS> channelLevelCurrentMa{};
+    std::array<float, MAX_LEVEL_CHANNELS> channelTankNoisePercent{};
+    std::array<float, MAX_LEVEL_CHANNELS> channelTankMeanCm{};
+    std::array<float, MAX_LEVEL_CHANNELS> channelTankStdDevCm{};
+    std::array<float, MAX_LEVEL_CHANNELS> channelTankEmptyEstimateCm{};
+    std::array<float, MAX_LEVEL_CHANNELS> channelTankFullEstimateCm{};
 
     bool pumpOn = false;
 };
@@ -87,6 +124,16 @@ struct LevelReading {
     float alphaBetaVelocity = 0.0f;
     float standardDeviation = 0.0f;
     float noisePercent = 0.0f;
+    uint8_t sampleCount = 0;
+    // Kalman estimate variance (NaN with alpha-beta) and the last residual.
+    float depthVarianceMm2 = NAN;
+    float innovationMm = NAN;
+};
+
+struct LevelFilterState {
+    float emaVoltage = NAN;
+    float filteredDepthMm = NAN;
+    float velocityMmPerSec = 0.0f;
 };
 
 struct FlowReading {
@@ -116,6 +163,199 @@ inline float pulsesToFlowLps(uint32_t pulses, float durationSeconds, float pulse
     return litersPerSecond;
 }
 
+// Cross-check of capture-path edges against the PCNT count for one meter.
+// The two counters are read a moment apart and a prescaled capture path
+// trails by a partial group, so the cumulative divergence wobbles within a
+// tolerance band without meaning anything. Only movement out of the band is
+// attributed, and the band then follows it: upward to pulses PCNT's glitch
+// filter rejected, downward to edges the capture path missed. Intervals in
+// which the capture path was reconfigured move the band without counting.
+struct EdgeCrossCheck {
+    int32_t intervalDelta = 0;
+    int64_t cumulativeDelta = 0;
+    uint64_t glitchRejections = 0;
+    uint64_t missedEdges = 0;
+    // Divergence already explained by the counters above or by resyncs.
+    int64_t attributedDelta = 0;
+
+    void update(uint32_t pcntPulses, uint32_t captureEdges, uint32_t toleranceEdges = 1, bool resynced = false) {
+        int64_t delta = static_cast<int64_t>(captureEdges) - static_cast<int64_t>(pcntPulses);
+        intervalDelta = static_cast<int32_t>(delta);
+        cumulativeDelta += delta;
+        int64_t excess = cumulativeDelta - attributedDelta;
+        if (resynced) {
+            attributedDelta = cumulativeDelta;
+        } else if (excess > static_cast<int64_t>(toleranceEdges)) {
+            glitchRejections += static_cast<uint64_t>(excess);
+            attributedDelta = cumulativeDelta;
+        } else if (excess < -static_cast<int64_t>(toleranceEdges)) {
+            missedEdges += static_cast<uint64_t>(-excess);
+            attributedDelta = cumulativeDelta;
+        }
+    }
+};
+
+// Reciprocal (period-based) flow: the pulses in a window divided by the exact
+// span between their first and last edge, so low flow is not quantized to
+// whole pulses per interval. Falls back to count/interval at high rates, and
+// while no edge arrives the estimate is bounded by 1 / time since last edge.
+class ReciprocalFlowEstimator {
+  public:
+    static constexpr uint32_t DEFAULT_COUNT_FALLBACK_PULSES = 200;
+    static constexpr uint32_t DEFAULT_STOP_TIMEOUT_US = 10000000;
+
+    void setCountFallbackPulses(uint32_t pulses) {
+        _countFallbackPulses = pulses < 2 ? 2 : pulses;
+    }
+
+    void setStopTimeoutUs(uint32_t timeoutUs) {
+        _stopTimeoutUs = timeoutUs;
+    }
+
+    // How late the capture backend may report the newest edge.
+    void setEdgeLatencyUs(uint32_t latencyUs) {
+        _edgeLatencyUs = latencyUs;
+    }
+
+    void reset() {
+        _frequencyHz = 0.0f;
+        _reciprocal = false;
+    }
+
+    // windowPulses: PCNT count; periodCount/periodSumUs: captured periods in
+    // the window; sinceLastEdgeUs: time from the newest edge to now.
+    float update(uint32_t windowPulses, float windowSeconds, uint32_t periodCount, uint64_t periodSumUs,
+                 uint32_t sinceLastEdgeUs, float pulsesPerLiter) {
+        if (pulsesPerLiter <= 0.0f) {
+            return 0.0f;
+        }
+        _reciprocal = periodCount > 0 && periodSumUs > 0 && windowPulses < _countFallbackPulses;
+        if (_reciprocal) {
+            _frequencyHz = static_cast<float>(periodCount) * 1000000.0f / static_cast<float>(periodSumUs);
+        } else if (windowPulses > 0) {
+            _frequencyHz = pulsesToFrequency(windowPulses, windowSeconds);
+        }
+        if (_reciprocal || windowPulses == 0) {
+            if (sinceLastEdgeUs >= _stopTimeoutUs) {
+                _frequencyHz = 0.0f;
+            } else if (sinceLastEdgeUs > _edgeLatencyUs) {
+                // No edge for longer than one period: the flow is at most 1 / gap.
+                float gapUs = static_cast<float>(sinceLastEdgeUs - _edgeLatencyUs);
+                if (_frequencyHz * gapUs > 1000000.0f) {
+                    _frequencyHz = 1000000.0f / gapUs;
+                }
+            }
+        }
+        return _frequencyHz / pulsesPerLiter;
+    }
+
+    bool usedReciprocal() const {
+        return _reciprocal;
+    }
+
+  private:
+    uint32_t _countFallbackPulses = DEFAULT_COUNT_FALLBACK_PULSES;
+    uint32_t _stopTimeoutUs = DEFAULT_STOP_TIMEOUT_US;
+    uint32_t _edgeLatencyUs = 0;
+    float _frequencyHz = 0.0f;
+    bool _reciprocal = false;
+};
+
+// Constant-velocity Kalman tracker for tank depth (mm). The measurement
+// variance is supplied per reading (the oversampled mean's squared standard
+// error); the white-acceleration process noise is scaled up or down until the
+// smoothed normalised innovation squared sits near its expected value of 1,
+// so the filter loosens during fills and drains and tightens when steady.
+class LevelKalmanFilter {
+  public:
+    static constexpr float DEFAULT_PROCESS_NOISE = 1.0f;  // mm^2/s^3
+    static constexpr float MIN_PROCESS_NOISE = 1e-4f;
+    static constexpr float MAX_PROCESS_NOISE = 1e4f;
+    static constexpr float INITIAL_VELOCITY_VARIANCE = 100.0f;  // (mm/s)^2
+    static constexpr float NIS_SMOOTHING = 0.3f;
+
+    void reset() {
+        _initialized = false;
+        _innovation = NAN;
+        _normalizedInnovation = 1.0f;
+        _processNoise = DEFAULT_PROCESS_NOISE;
+    }
+
+    // Seeds the state, e.g. from a checkpoint or the alpha-beta filter.
+    void restore(float depthMm, float velocityMmPerSec, float depthVarianceMm2) {
+        if (isnan(depthMm)) {
+            reset();
+            return;
+        }
+        _depth = depthMm;
+        _velocity = isnan(velocityMmPerSec) ? 0.0f : velocityMmPerSec;
+        _p00 = depthVarianceMm2;
+        _p01 = 0.0f;
+        _p11 = INITIAL_VELOCITY_VARIANCE;
+        _initialized = true;
+    }
+
+    float update(float depthMm, float measurementVarianceMm2, float dt) {
+        if (isnan(depthMm)) {
+            return _initialized ? _depth : NAN;
+        }
+        float r = measurementVarianceMm2 > 1e-6f ? measurementVarianceMm2 : 1e-6f;
+        if (!_initialized) {
+            restore(depthMm, 0.0f, r);
+            _innovation = 0.0f;
+            return _depth;
+        }
+        dt = dt > 0.0f ? dt : 1.0f;
+
+        float dt2 = dt * dt;
+        float q = _processNoise;
+        _depth += _velocity * dt;
+        _p00 += dt * 2.0f * _p01 + dt2 * _p11 + q * dt2 * dt2 / 4.0f;
+        _p01 += dt * _p11 + q * dt2 * dt / 2.0f;
+        _p11 += q * dt2;
+
+        float innovation = depthMm - _depth;
+        float s = _p00 + r;
+        float k0 = _p00 / s;
+        float k1 = _p01 / s;
+        _depth += k0 * innovation;
+        _velocity += k1 * innovation;
+        _p11 -= k1 * _p01;
+        _p00 *= 1.0f - k0;
+        _p01 *= 1.0f - k0;
+
+        _innovation = innovation;
+        _normalizedInnovation += NIS_SMOOTHING * (innovation * innovation / s - _normalizedInnovation);
+        float scale = sqrtf(clampValue(_normalizedInnovation, 0.5f, 2.0f));
+        _processNoise = clampValue(_processNoise * scale, MIN_PROCESS_NOISE, MAX_PROCESS_NOISE);
+        return _depth;
+    }
+
+    // Pins the estimate at an empty tank without disturbing the covariance.
+    void clampToZero() {
+        _depth = 0.0f;
+        _velocity = 0.0f;
+    }
+
+    bool initialized() const { return _initialized; }
+    float depthMm() const { return _initialized ? _depth : NAN; }
+    float velocityMmPerSec() const { return _initialized ? _velocity : 0.0f; }
+    float depthVarianceMm2() const { return _initialized ? _p00 : NAN; }
+    float innovationMm() const { return _innovation; }
+    float processNoise() const { return _processNoise; }
+
+  private:
+    bool _initialized = false;
+    float _depth = 0.0f;
+    float _velocity = 0.0f;
+    float _p00 = 0.0f;
+    float _p01 = 0.0f;
+    float _p11 = 0.0f;
+    float _innovation = NAN;
+    float _normalizedInnovation = 1.0f;
+    float _processNoise = DEFAULT_PROCESS_NOISE;
+};
+
 inline float voltageToHeightCm(float voltage, float zeroVoltage, float fullScaleVoltage, float fullScaleHeightCm, float densityFactor) {
     float numerator = voltage - zeroVoltage;
     float denominator = fullScaleVoltage - zeroVoltage;
@@ -154,56 +394,386 @@ inline String qualitativeNoise(float noisePercent) {
     return "poor";
 }
 
-class RollingStats {
+// Standard reflected CRC-32 (poly 0xEDB88320) for persisted state blobs.
+inline uint32_t crc32(const void* data, size_t length) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; ++i) {
+        crc ^= bytes[i];
+        for (uint8_t bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+// Neumaier-compensated float accumulator. The ESP32 FPU is single precision
+// only, so the statistics kernels below stay in float instead of paying for
+// soft-float doubles. Precision budget: the compensated total of n terms is
+// within about 2 ulp of the exact sum (|error| <= 2 * 6e-8 * sum|x_i|),
+// independent of n, versus n * 6e-8 for a naive float loop.
+class CompensatedSum {
   public:
-    explicit RollingStats(size_t maxSamples = 300) : _maxSamples(maxSamples) {}
+    void add(float value) {
+        float total = _sum + value;
+        if (fabsf(_sum) >= fabsf(value)) {
+            _compensation += (_sum - total) + value;
+        } else {
+            _compensation += (value - total) + _sum;
+        }
+        _sum = total;
+    }
+
+    void clear() {
+        _sum = 0.0f;
+        _compensation = 0.0f;
+    }
+
+    float value() const {
+        return _sum + _compensation;
+    }
+
+  private:
+    float _sum = 0.0f;
+    float _compensation = 0.0f;
+};
+
+// Window storage policies for BasicRollingStats. DynamicWindow keeps the
+// runtime-sized setMaxSamples() behaviour on the heap; FixedWindow<N> holds
+// every buffer in std::array so the window can live in static storage.
+template <typename T>
+class DynamicBuffer {
+  public:
+    void resize(size_t size, const T& fill) {
+        _data.resize(size, fill);
+    }
+    T& operator[](size_t index) { return _data[index]; }
+    const T& operator[](size_t index) const { return _data[index]; }
+    T* data() { return _data.data(); }
+
+  private:
+    std::vector<T> _data;
+};
+
+template <typename T, size_t N>
+class FixedBuffer {
+  public:
+    void resize(size_t, const T&) {}
+    T& operator[](size_t index) { return _data[index]; }
+    const T& operator[](size_t index) const { return _data[index]; }
+    T* data() { return _data.data(); }
+
+  private:
+    std::array<T, N> _data{};
+};
+
+struct DynamicWindow {
+    static constexpr size_t MAX_SAMPLES = 0xFFFE;
+    static constexpr size_t DEFAULT_SAMPLES = 300;
+    template <typename T>
+    using Buffer = DynamicBuffer<T>;
+};
+
+template <size_t N>
+struct FixedWindow {
+    static_assert(N >= 2 && N <= 0xFFFE, "FixedWindow size must fit 16-bit slot ids");
+    static constexpr size_t MAX_SAMPLES = N;
+    static constexpr size_t DEFAULT_SAMPLES = N;
+    template <typename T>
+    using Buffer = FixedBuffer<T, N>;
+};
+
+// Order-statistic index over the samples of a RollingStats window. Implemented
+// as an array-backed treap whose node ids are the window slots, so insert,
+// erase and k-th queries are O(log n) and nothing is allocated after
+// setCapacity().
+template <typename Window>
+class OrderStatisticIndex {
+  public:
+    static constexpr uint16_t NIL = 0xFFFF;
+
+    void setCapacity(size_t capacity) {
+        _values.resize(capacity, 0.0f);
+        _left.resize(capacity, NIL);
+        _right.resize(capacity, NIL);
+        _count.resize(capacity, 0);
+        _priority.resize(capacity, 0);
+        _root = NIL;
+    }
+
+    void clear() {
+        _root = NIL;
+    }
+
+    size_t size() const {
+        return nodeCount(_root);
+    }
+
+    void insert(uint16_t slot, float value) {
+        _values[slot] = value;
+        _left[slot] = NIL;
+        _right[slot] = NIL;
+        _count[slot] = 1;
+        _priority[slot] = nextPriority();
+        _root = insertNode(_root, slot);
+    }
+
+    void erase(uint16_t slot) {
+        _root = eraseNode(_root, slot);
+    }
+
+    // Returns the k-th smallest value (0-based); k must be < size().
+    float kth(size_t k) const {
+        uint16_t node = _root;
+        while (node != NIL) {
+            size_t leftCount = nodeCount(_left[node]);
+            if (k < leftCount) {
+                node = _left[node];
+            } else if (k == leftCount) {
+                return _values[node];
+            } else {
+                k -= leftCount + 1;
+                node = _right[node];
+            }
+        }
+        return NAN;
+    }
+
+  private:
+    template <typename T>
+    using Buffer = typename Window::template Buffer<T>;
+
+    size_t nodeCount(uint16_t node) const {
+        return node == NIL ? 0 : _count[node];
+    }
+
+    bool precedes(uint16_t a, uint16_t b) const {
+        return _values[a] < _values[b] || (!(_values[b] < _values[a]) && a < b);
+    }
+
+    void refresh(uint16_t node) {
+        _count[node] = static_cast<uint16_t>(1 + nodeCount(_left[node]) + nodeCount(_right[node]));
+    }
+
+    uint16_t rotateRight(uint16_t node) {
+        uint16_t pivot = _left[node];
+        _left[node] = _right[pivot];
+        _right[pivot] = node;
+        refresh(node);
+        refresh(pivot);
+        return pivot;
+    }
+
+    uint16_t rotateLeft(uint16_t node) {
+        uint16_t pivot = _right[node];
+        _right[node] = _left[pivot];
+        _left[pivot] = node;
+        refresh(node);
+        refresh(pivot);
+        return pivot;
+    }
+
+    uint16_t insertNode(uint16_t node, uint16_t slot) {
+        if (node == NIL) {
+            return slot;
+        }
+        if (precedes(slot, node)) {
+            _left[node] = insertNode(_left[node], slot);
+            refresh(node);
+            if (_priority[_left[node]] > _priority[node]) {
+                node = rotateRight(node);
+            }
+        } else {
+            _right[node] = insertNode(_right[node], slot);
+            refresh(node);
+            if (_priority[_right[node]] > _priority[node]) {
+                node = rotateLeft(node);
+            }
+        }
+        return node;
+    }
+
+    uint16_t eraseNode(uint16_t node, uint16_t slot) {
+        if (node == NIL) {
+            return NIL;
+        }
+        if (node == slot) {
+            return merge(_left[node], _right[node]);
+        }
+        if (precedes(slot, node)) {
+            _left[node] = eraseNode(_left[node], slot);
+        } else {
+            _right[node] = eraseNode(_right[node], slot);
+        }
+        refresh(node);
+        return node;
+    }
+
+    uint16_t merge(uint16_t a, uint16_t b) {
+        if (a == NIL) {
+            return b;
+        }
+        if (b == NIL) {
+            return a;
+        }
+        if (_priority[a] > _priority[b]) {
+            _right[a] = merge(_right[a], b);
+            refresh(a);
+            return a;
+        }
+        _left[b] = merge(a, _left[b]);
+        refresh(b);
+        return b;
+    }
+
+    uint32_t nextPriority() {
+        _seed ^= _seed << 13;
+        _seed ^= _seed >> 17;
+        _seed ^= _seed << 5;
+        return _seed;
+    }
+
+    Buffer<float> _values;
+    Buffer<uint16_t> _left;
+    Buffer<uint16_t> _right;
+    Buffer<uint16_t> _count;
+    Buffer<uint32_t> _priority;
+    uint16_t _root = NIL;
+    uint32_t _seed = 0x9E3779B9u;
+};
+
+template <typename Window>
+constexpr uint16_t OrderStatisticIndex<Window>::NIL;
+
+// Bounded deque of window slots used for the monotonic min/max queues.
+template <typename Window>
+class SlotQueue {
+  public:
+    void setCapacity(size_t capacity) {
+        _slots.resize(capacity, 0);
+        _capacity = capacity;
+        clear();
+    }
+
+    void clear() {
+        _head = 0;
+        _count = 0;
+    }
+
+    bool empty() const { return _count == 0; }
+    uint16_t front() const { return _slots[_head]; }
+    uint16_t back() const { return _slots[(_head + _count - 1) % _capacity]; }
+
+    void pushBack(uint16_t slot) {
+        _slots[(_head + _count) % _capacity] = slot;
+        _count++;
+    }
+
+    void popBack() {
+        _count--;
+    }
+
+    void popFront() {
+        _head = (_head + 1) % _capacity;
+        _count--;
+    }
+
+  private:
+    typename Window::template Buffer<uint16_t> _slots;
+    size_t _capacity = 0;
+    size_t _head = 0;
+    size_t _count = 0;
+};
+
+template <typename Window>
+class BasicRollingStats {
+  public:
+    explicit BasicRollingStats(size_t maxSamples = Window::DEFAULT_SAMPLES)
+        : _maxSamples(clampValue<size_t>(maxSamples, 2, Window::MAX_SAMPLES)) {
+        _samples.resize(_maxSamples, 0.0f);
+        rebuildIndexes();
+    }
 
     void setMaxSamples(size_t samples) {
-        _maxSamples = std::max<size_t>(2, samples);
-        trim();
+        samples = clampValue<size_t>(samples, 2, Window::MAX_SAMPLES);
+        linearize();
+        if (_count > samples) {
+            std::copy(_samples.data() + (_count - samples), _samples.data() + _count, _samples.data());
+            _count = samples;
+        }
+        _maxSamples = samples;
+        _samples.resize(_maxSamples, 0.0f);
+        rebuildIndexes();
+        reanchorMoments();
     }
 
     void add(float value) {
-        _history.push_back(value);
-        if (_history.size() > _maxSamples) {
-            _history.pop_front();
+        if (_count == 0) {
+            _anchor = value;
+        }
+        if (_count >= _maxSamples) {
+            uint16_t oldest = static_cast<uint16_t>(_head);
+            _order.erase(oldest);
+            evictExtremes(oldest);
+            removeMoment(_samples[oldest]);
+            _head = (_head + 1) % _maxSamples;
+            _count--;
+        }
+        uint16_t slot = slotAt(_count);
+        _samples[slot] = value;
+        _count++;
+        _order.insert(slot, value);
+        pushExtremes(slot);
+        addMoment(value);
+        if (++_updatesSinceAnchor >= _maxSamples) {
+            reanchorMoments();
         }
     }
 
     size_t size() const {
-        return _history.size();
+        return _count;
+    }
+
+    size_t capacity() const {
+        return _maxSamples;
     }
 
     bool empty() const {
-        return _history.empty();
+        return _count == 0;
     }
 
     void clear() {
-        _history.clear();
+        _head = 0;
+        _count = 0;
+        _order.clear();
+        _minQueue.clear();
+        _maxQueue.clear();
+        _anchor = 0.0f;
+        _shiftedSum.clear();
+        _shiftedSquares.clear();
+        _updatesSinceAnchor = 0;
+    }
+
+    // Sample by age, 0 being the oldest in the window.
+    float at(size_t index) const {
+        return _samples[slotAt(index)];
     }
 
     float mean() const {
-        if (_history.empty()) {
+        if (_count == 0) {
             return NAN;
         }
-        double sum = 0.0;
-        for (float v : _history) {
-            sum += v;
-        }
-        return static_cast<float>(sum / static_cast<double>(_history.size()));
+        return _anchor + _shiftedSum.value() / static_cast<float>(_count);
     }
 
     float variance() const {
-        if (_history.size() < 2) {
+        if (_count < 2) {
             return NAN;
         }
-        float m = mean();
-        double sum = 0.0;
-        for (float v : _history) {
-            double diff = static_cast<double>(v) - m;
-            sum += diff * diff;
-        }
-        return static_cast<float>(sum / static_cast<double>(_history.size() - 1));
+        float n = static_cast<float>(_count);
+        float shifted = _shiftedSum.value();
+        float m2 = _shiftedSquares.value() - shifted * shifted / n;
+        return std::max(0.0f, m2) / (n - 1.0f);
     }
 
     float stddev() const {
@@ -212,53 +782,487 @@ class RollingStats {
     }
 
     float min() const {
-        if (_history.empty()) {
+        if (_minQueue.empty()) {
             return NAN;
         }
-        return *std::min_element(_history.begin(), _history.end());
+        return _samples[_minQueue.front()];
     }
 
     float max() const {
-        if (_history.empty()) {
+        if (_maxQueue.empty()) {
             return NAN;
         }
-        return *std::max_element(_history.begin(), _history.end());
+        return _samples[_maxQueue.front()];
     }
 
     float percentile(float percent) const {
-        if (_history.empty()) {
+        if (_count == 0) {
             return NAN;
         }
         percent = clampValue(percent, 0.0f, 100.0f);
-        std::vector<float> sorted(_history.begin(), _history.end());
-        std::sort(sorted.begin(), sorted.end());
-        float rank = percent / 100.0f * (sorted.size() - 1);
+        float rank = percent / 100.0f * (_count - 1);
         size_t lower = static_cast<size_t>(floorf(rank));
         size_t upper = static_cast<size_t>(ceilf(rank));
-        if (upper >= sorted.size()) {
-            upper = sorted.size() - 1;
+        if (upper >= _count) {
+            upper = _count - 1;
         }
         float fraction = rank - lower;
-        return sorted[lower] + (sorted[upper] - sorted[lower]) * fraction;
+        float lowerValue = _order.kth(lower);
+        float upperValue = (upper == lower) ? lowerValue : _order.kth(upper);
+        return lowerValue + (upperValue - lowerValue) * fraction;
     }
 
     float median() const {
         return percentile(50.0f);
     }
 
-    const std::deque<float>& history() const {
-        return _history;
+    // Several percentiles in one call, e.g. quantiles({50.0f, 90.0f}). Each
+    // rank is an O(log n) descent of the order-statistic index, so callers can
+    // ask for extra columns without re-sorting the window.
+    template <size_t K>
+    std::array<float, K> quantiles(const float (&percents)[K]) const {
+        std::array<float, K> result;
+        for (size_t i = 0; i < K; ++i) {
+            result[i] = percentile(percents[i]);
+        }
+        return result;
     }
 
   private:
-    void trim() {
-        while (_history.size() > _maxSamples) {
-            _history.pop_front();
+    uint16_t slotAt(size_t index) const {
+        return static_cast<uint16_t>((_head + index) % _maxSamples);
+    }
+
+    // Rotates the ring so the oldest sample sits in slot 0.
+    void linearize() {
+        if (_head != 0) {
+            std::rotate(_samples.data(), _samples.data() + _head, _samples.data() + _maxSamples);
+            _head = 0;
         }
     }
 
-    std::deque<float> _history;
+    // Moments are compensated float sums of (x - anchor). With the anchor near
+    // the window mean the variance error stays around 2 * 6e-8 * (sigma^2 +
+    // (mean - anchor)^2), instead of cancelling against mean^2.
+    void addMoment(float value) {
+        float delta = value - _anchor;
+        _shiftedSum.add(delta);
+        _shiftedSquares.add(delta * delta);
+    }
+
+    void removeMoment(float value) {
+        float delta = value - _anchor;
+        _shiftedSum.add(-delta);
+        _shiftedSquares.add(-(delta * delta));
+    }
+
+    // Once per window length the anchor moves to the current mean and the sums
+    // are rebuilt from the samples, so neither rounding from add/remove nor a
+    // drifting level can accumulate over weeks of uptime.
+    void reanchorMoments() {
+        _updatesSinceAnchor = 0;
+        _shiftedSum.clear();
+        _shiftedSquares.clear();
+        if (_count == 0) {
+            _anchor = 0.0f;
+            return;
+        }
+        CompensatedSum total;
+        for (size_t i = 0; i < _count; ++i) {
+            total.add(at(i));
+        }
+        _anchor = total.value() / static_cast<float>(_count);
+        for (size_t i = 0; i < _count; ++i) {
+            addMoment(at(i));
+        }
+    }
+
+    // Monotonic queues: _minQueue values increase and _maxQueue values
+    // decrease from front to back, so the window extremes sit at the front.
+    void pushExtremes(uint16_t slot) {
+        float value = _samples[slot];
+        while (!_minQueue.empty() && _samples[_minQueue.back()] >= value) {
+            _minQueue.popBack();
+        }
+        _minQueue.pushBack(slot);
+        while (!_maxQueue.empty() && _samples[_maxQueue.back()] <= value) {
+            _maxQueue.popBack();
+        }
+        _maxQueue.pushBack(slot);
+    }
+
+    void evictExtremes(uint16_t slot) {
+        if (!_minQueue.empty() && _minQueue.front() == slot) {
+            _minQueue.popFront();
+        }
+        if (!_maxQueue.empty() && _maxQueue.front() == slot) {
+            _maxQueue.popFront();
+        }
+    }
+
+    void rebuildIndexes() {
+        _order.setCapacity(_maxSamples);
+        _minQueue.setCapacity(_maxSamples);
+        _maxQueue.setCapacity(_maxSamples);
+        for (size_t i = 0; i < _count; ++i) {
+            uint16_t slot = slotAt(i);
+            _order.insert(slot, _samples[slot]);
+            pushExtremes(slot);
+        }
+    }
+
+    typename Window::template Buffer<float> _samples;
     size_t _maxSamples;
+    size_t _head = 0;
+    size_t _count = 0;
+    OrderStatisticIndex<Window> _order;
+    SlotQueue<Window> _minQueue;
+    SlotQueue<Window> _maxQueue;
+    float _anchor = 0.0f;
+    CompensatedSum _shiftedSum;
+    CompensatedSum _shiftedSquares;
+    size_t _updatesSinceAnchor = 0;
+};
+
+using RollingStats = BasicRollingStats<DynamicWindow>;
+
+template <size_t N>
+using FixedRollingStats = BasicRollingStats<FixedWindow<N>>;
+
+// Streaming quantile sketch over log-spaced bins. Every bin spans a constant
+// ratio, so any quantile inside [minValue, maxValue] is returned within
+// relativeErrorPercent() of the exact rank value while the memory stays at
+// BINS counters. Once horizonSamples have been counted all bins are halved,
+// which ages older data out geometrically instead of keeping a raw window.
+template <size_t BINS>
+class QuantileSketch {
+  public:
+    QuantileSketch(float minValue, float maxValue, uint32_t horizonSamples) {
+        setHorizonSamples(horizonSamples);
+        configure(minValue, maxValue);
+    }
+
+    void configure(float minValue, float maxValue) {
+        _minValue = std::max(minValue, EPSILON);
+        maxValue = std::max(maxValue, _minValue * 1.001f);
+        _logGamma = logf(maxValue / _minValue) / static_cast<float>(BINS);
+        _inverseLogGamma = 1.0f / _logGamma;
+        float gamma = expf(_logGamma);
+        _representativeScale = 2.0f * gamma / (gamma + 1.0f);
+        _relativeError = (gamma - 1.0f) / (gamma + 1.0f);
+        clear();
+    }
+
+    // Halving rounds up, so a horizon below 2 * BINS could never be reached.
+    void setHorizonSamples(uint32_t samples) {
+        _horizonSamples = std::max<uint32_t>(samples, 2 * BINS);
+    }
+
+    void clear() {
+        _bins.fill(0);
+        _total = 0;
+    }
+
+    void add(float value) {
+        if (isnan(value)) {
+            return;
+        }
+        _bins[binIndex(value)]++;
+        _total++;
+        if (_total >= _horizonSamples) {
+            decay();
+        }
+    }
+
+    float quantile(float percent) const {
+        if (_total == 0) {
+            return NAN;
+        }
+        uint32_t rank = rankOf(percent);
+        uint32_t cumulative = 0;
+        for (size_t i = 0; i < BINS; ++i) {
+            cumulative += _bins[i];
+            if (cumulative > rank) {
+                return binValue(i);
+            }
+        }
+        return binValue(BINS - 1);
+    }
+
+    // Resolves all requested percentiles in a single cumulative pass over the bins.
+    template <size_t K>
+    std::array<float, K> quantiles(const float (&percents)[K]) const {
+        std::array<float, K> result;
+        result.fill(NAN);
+        if (_total == 0) {
+            return result;
+        }
+        std::array<size_t, K> order;
+        for (size_t i = 0; i < K; ++i) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [&percents](size_t a, size_t b) { return percents[a] < percents[b]; });
+        size_t next = 0;
+        uint32_t cumulative = 0;
+        for (size_t bin = 0; bin < BINS && next < K; ++bin) {
+            cumulative += _bins[bin];
+            while (next < K && rankOf(percents[order[next]]) < cumulative) {
+                result[order[next]] = binValue(bin);
+                next++;
+            }
+        }
+        for (; next < K; ++next) {
+            result[order[next]] = binValue(BINS - 1);
+        }
+        return result;
+    }
+
+    float relativeErrorPercent() const {
+        return _relativeError * 100.0f;
+    }
+
+    uint32_t count() const {
+        return _total;
+    }
+
+    const std::array<uint32_t, BINS>& bins() const {
+        return _bins;
+    }
+
+    // Folds previously exported bins (same range and BINS) into this sketch.
+    void merge(const std::array<uint32_t, BINS>& bins) {
+        for (size_t i = 0; i < BINS; ++i) {
+            _bins[i] += bins[i];
+            _total += bins[i];
+        }
+        // Each halving at least halves the excess over 2 * BINS, so 32 reach the
+        // horizon from any uint32_t total.
+        for (uint8_t halvings = 0; halvings < 32 && _total >= _horizonSamples; ++halvings) {
+            decay();
+        }
+    }
+
+  private:
+    uint32_t rankOf(float percent) const {
+        percent = clampValue(percent, 0.0f, 100.0f);
+        return static_cast<uint32_t>(percent / 100.0f * static_cast<float>(_total - 1));
+    }
+
+    size_t binIndex(float value) const {
+        if (value <= _minValue) {
+            return 0;
+        }
+        float position = logf(value / _minValue) * _inverseLogGamma;
+        if (position >= static_cast<float>(BINS - 1)) {
+            return BINS - 1;
+        }
+        return static_cast<size_t>(position);
+    }
+
+    float binValue(size_t index) const {
+        return _minValue * expf(_logGamma * static_cast<float>(index)) * _representativeScale;
+    }
+
+    void decay() {
+        _total = 0;
+        for (auto& bin : _bins) {
+            bin = (bin + 1) / 2;
+            _total += bin;
+        }
+    }
+
+    std::array<uint32_t, BINS> _bins{};
+    uint32_t _total = 0;
+    uint32_t _horizonSamples = 2 * BINS;
+    float _minValue = 0.0f;
+    float _logGamma = 0.0f;
+    float _inverseLogGamma = 0.0f;
+    float _representativeScale = 1.0f;
+    float _relativeError = 0.0f;
+};
+
+// count/mean/min/max/spread summary of a group of samples. Spread is kept as
+// the float sum of squared deviations (Welford, merged with Chan's update), so
+// buckets can be combined without the sumsq - sum^2/n cancellation that float
+// accumulators would suffer over a day of samples.
+struct BucketStats {
+    uint32_t count = 0;
+    float center = 0.0f;
+    float m2 = 0.0f;
+    float min = NAN;
+    float max = NAN;
+
+    void add(float value) {
+        count++;
+        float delta = value - center;
+        center += delta / static_cast<float>(count);
+        m2 += delta * (value - center);
+        min = (isnan(min) || value < min) ? value : min;
+        max = (isnan(max) || value > max) ? value : max;
+    }
+
+    void merge(const BucketStats& other) {
+        if (other.count == 0) {
+            return;
+        }
+        if (count == 0) {
+            *this = other;
+            return;
+        }
+        float total = static_cast<float>(count + other.count);
+        float delta = other.center - center;
+        center += delta * (static_cast<float>(other.count) / total);
+        m2 += other.m2 + delta * delta * (static_cast<float>(count) * static_cast<float>(other.count) / total);
+        count += other.count;
+        min = (other.min < min) ? other.min : min;
+        max = (other.max > max) ? other.max : max;
+    }
+
+    float sum() const {
+        return center * static_cast<float>(count);
+    }
+
+    float mean() const {
+        return count == 0 ? NAN : center;
+    }
+
+    float stddev() const {
+        if (count < 2) {
+            return NAN;
+        }
+        return sqrtf(std::max(0.0f, m2) / static_cast<float>(count - 1));
+    }
+};
+
+template <size_t N>
+class BucketRing {
+  public:
+    void push(const BucketStats& bucket) {
+        _buckets[_head] = bucket;
+        _head = (_head + 1) % N;
+        if (_count < N) {
+            _count++;
+        }
+    }
+
+    void clear() {
+        _head = 0;
+        _count = 0;
+    }
+
+    // Merge of the newest min(n, size) buckets.
+    BucketStats newest(size_t n) const {
+        BucketStats result;
+        size_t count = n < _count ? n : _count;
+        for (size_t i = 1; i <= count; ++i) {
+            result.merge(_buckets[(_head + N - i) % N]);
+        }
+        return result;
+    }
+
+  private:
+    std::array<BucketStats, N> _buckets{};
+    size_t _head = 0;
+    size_t _count = 0;
+};
+
+// Folds raw samples into per-minute, per-hour and per-day buckets so the last
+// hour, day or week can be summarised in O(buckets) from a fixed footprint of
+// sizeof(DownsampleHierarchy) bytes. Time is uptime seconds; a sample only
+// closes buckets, it never reopens them. Each horizon merges the newest N-1
+// closed buckets with the open one, so it never spans more than its nominal
+// length (60 minutes, 24 hours, 7 days).
+class DownsampleHierarchy {
+  public:
+    static constexpr size_t MINUTE_BUCKETS = 60;
+    static constexpr size_t HOUR_BUCKETS = 24;
+    static constexpr size_t DAY_BUCKETS = 7;
+
+    enum class Horizon : uint8_t { Hour, Day, Week };
+
+    void add(float value, uint32_t nowSeconds) {
+        if (isnan(value)) {
+            return;
+        }
+        advanceTo(nowSeconds / 60);
+        _openMinute.add(value);
+    }
+
+    void clear() {
+        _minutes.clear();
+        _hours.clear();
+        _days.clear();
+        _openMinute = BucketStats();
+        _openHour = BucketStats();
+        _openDay = BucketStats();
+        _started = false;
+    }
+
+    BucketStats summary(Horizon horizon) const {
+        BucketStats result;
+        switch (horizon) {
+            case Horizon::Hour:
+                result = _minutes.newest(MINUTE_BUCKETS - 1);
+                break;
+            case Horizon::Day:
+                result = _hours.newest(HOUR_BUCKETS - 1);
+                result.merge(_openHour);
+                break;
+            case Horizon::Week:
+                result = _days.newest(DAY_BUCKETS - 1);
+                result.merge(_openDay);
+                result.merge(_openHour);
+                break;
+        }
+        result.merge(_openMinute);
+        return result;
+    }
+
+  private:
+    void advanceTo(uint32_t minute) {
+        if (!_started || minute < _currentMinute) {
+            clear();
+            _started = true;
+            _currentMinute = minute;
+            return;
+        }
+        if (minute - _currentMinute > MINUTE_BUCKETS * HOUR_BUCKETS * DAY_BUCKETS) {
+            clear();
+            _started = true;
+            _currentMinute = minute;
+            return;
+        }
+        while (_currentMinute < minute) {
+            closeMinute();
+        }
+    }
+
+    void closeMinute() {
+        _minutes.push(_openMinute);
+        _openHour.merge(_openMinute);
+        _openMinute = BucketStats();
+        _currentMinute++;
+        if (_currentMinute % MINUTE_BUCKETS != 0) {
+            return;
+        }
+        _hours.push(_openHour);
+        _openDay.merge(_openHour);
+        _openHour = BucketStats();
+        if ((_currentMinute / MINUTE_BUCKETS) % HOUR_BUCKETS != 0) {
+            return;
+        }
+        _days.push(_openDay);
+        _openDay = BucketStats();
+    }
+
+    BucketRing<MINUTE_BUCKETS> _minutes;
+    BucketRing<HOUR_BUCKETS> _hours;
+    BucketRing<DAY_BUCKETS> _days;
+    BucketStats _openMinute;
+    BucketStats _openHour;
+    BucketStats _openDay;
+    uint32_t _currentMinute = 0;
+    bool _started = false;
 };
 
 struct FlowAnalyticsResult {
@@ -269,42 +1273,129 @@ struct FlowAnalyticsResult {
     float stdDevLps = NAN;
     float minLps = NAN;
     float maxLps = NAN;
+    float p25Lps = NAN;
+    float p75Lps = NAN;
+    float p99Lps = NAN;
+    float longBaselineLps = NAN;
+    float longMinHealthyLps = NAN;
+    float longQuantileErrorPercent = NAN;
+    float hourMeanLps = NAN;
+    float dayMeanLps = NAN;
     bool pumpOn = false;
 };
 
+// Analytics are split into a cheap add() per sample and a memoized result()
+// that derives the statistics only when a consumer asks for them; repeated
+// result() calls between samples reuse the cached values.
 class FlowAnalytics {
   public:
-    FlowAnalytics() : _overall(300), _pumpSamples(300) {}
+    static constexpr size_t LONG_HORIZON_BINS = 128;
 
-    FlowAnalyticsResult update(float flowLps) {
-        FlowAnalyticsResult result;
-        if (isnan(flowLps)) {
-            return result;
+    // Compact state persisted across reboots: the long-horizon baseline.
+    struct State {
+        std::array<uint32_t, LONG_HORIZON_BINS> longHorizonBins{};
+    };
+
+    FlowAnalytics() : _pumpSketch(0.05f, 100.0f, 86400) {}
+
+    State state() const {
+        State saved;
+        saved.longHorizonBins = _pumpSketch.bins();
+        return saved;
+    }
+
+    void restore(const State& saved) {
+        _pumpSketch.merge(saved.longHorizonBins);
+        _dirty = true;
+    }
+
+    // Number of pump-on samples the long baseline sketch should span.
+    void setLongHorizonSamples(uint32_t samples) {
+        _pumpSketch.setHorizonSamples(samples);
+    }
+
+    void add(float flowLps, uint32_t nowSeconds) {
+        _dirty = true;
+        _lastValid = !isnan(flowLps);
+        if (!_lastValid) {
+            _pumpOn = false;
+            return;
         }
         _overall.add(flowLps);
-        result.meanLps = _overall.mean();
-        result.medianLps = _overall.median();
-        result.stdDevLps = _overall.stddev();
-        result.minLps = _overall.min();
-        result.maxLps = _overall.max();
-
-        bool pumpOn = flowLps > 0.05f;
-        result.pumpOn = pumpOn;
-        if (pumpOn) {
+        _history.add(flowLps, nowSeconds);
+        _pumpOn = flowLps > 0.05f;
+        if (_pumpOn) {
             _pumpSamples.add(flowLps);
+            _pumpSketch.add(flowLps);
         }
+    }
 
-        if (!_pumpSamples.empty()) {
-            result.baselineLps = _pumpSamples.percentile(90.0f);
-            result.minHealthyLps = _pumpSamples.percentile(10.0f);
+    bool pumpOn() const {
+        return _pumpOn;
+    }
+
+    // Recomputed only after add() or restore() changed the windows.
+    const FlowAnalyticsResult& result() {
+        if (_dirty) {
+            recompute();
+            _dirty = false;
+            _recomputeCount++;
         }
+        return _result;
+    }
 
-        return result;
+    uint32_t recomputeCount() const {
+        return _recomputeCount;
+    }
+
+    FlowAnalyticsResult update(float flowLps, uint32_t nowSeconds) {
+        add(flowLps, nowSeconds);
+        return result();
+    }
+
+    const DownsampleHierarchy& history() const {
+        return _history;
     }
 
   private:
-    RollingStats _overall;
-    RollingStats _pumpSamples;
+    void recompute() {
+        _result = FlowAnalyticsResult();
+        if (!_lastValid) {
+            return;
+        }
+        std::array<float, 4> spread = _overall.quantiles({50.0f, 25.0f, 75.0f, 99.0f});
+        _result.meanLps = _overall.mean();
+        _result.medianLps = spread[0];
+        _result.p25Lps = spread[1];
+        _result.p75Lps = spread[2];
+        _result.p99Lps = spread[3];
+        _result.stdDevLps = _overall.stddev();
+        _result.minLps = _overall.min();
+        _result.maxLps = _overall.max();
+        _result.hourMeanLps = _history.summary(DownsampleHierarchy::Horizon::Hour).mean();
+        _result.dayMeanLps = _history.summary(DownsampleHierarchy::Horizon::Day).mean();
+        _result.pumpOn = _pumpOn;
+
+        if (!_pumpSamples.empty()) {
+            std::array<float, 2> recent = _pumpSamples.quantiles({90.0f, 10.0f});
+            std::array<float, 2> longHorizon = _pumpSketch.quantiles({90.0f, 10.0f});
+            _result.baselineLps = recent[0];
+            _result.minHealthyLps = recent[1];
+            _result.longBaselineLps = longHorizon[0];
+            _result.longMinHealthyLps = longHorizon[1];
+            _result.longQuantileErrorPercent = _pumpSketch.relativeErrorPercent();
+        }
+    }
+
+    FixedRollingStats<300> _overall;
+    FixedRollingStats<300> _pumpSamples;
+    QuantileSketch<LONG_HORIZON_BINS> _pumpSketch;
+    DownsampleHierarchy _history;
+    FlowAnalyticsResult _result;
+    bool _pumpOn = false;
+    bool _lastValid = false;
+    bool _dirty = true;
+    uint32_t _recomputeCount = 0;
 };
 
 struct LevelAnalyticsResult {
@@ -315,23 +1406,42 @@ struct LevelAnalyticsResult {
     float stdDevCm = NAN;
     float minCm = NAN;
     float maxCm = NAN;
+    float dayMinCm = NAN;
+    float dayMaxCm = NAN;
 };
 
 class LevelAnalytics {
   public:
-    LevelAnalytics() : _allSamples(600) {}
+    struct State {
+        float emptyEstimateCm = NAN;
+        float fullEstimateCm = NAN;
+    };
 
-    LevelAnalyticsResult update(float heightCm, float noisePercent) {
-        LevelAnalyticsResult result;
-        if (isnan(heightCm)) {
-            return result;
+    LevelAnalytics() = default;
+
+    State state() const {
+        State saved;
+        saved.emptyEstimateCm = _emptyEstimate;
+        saved.fullEstimateCm = _fullEstimate;
+        return saved;
+    }
+
+    void restore(const State& saved) {
+        _emptyEstimate = saved.emptyEstimateCm;
+        _fullEstimate = saved.fullEstimateCm;
+        _dirty = true;
+    }
+
+    // The empty/full estimates are exponential averages that must see every
+    // sample, so they stay in add(); the window statistics are deferred.
+    void add(float heightCm, float noisePercent, uint32_t nowSeconds) {
+        _dirty = true;
+        _lastValid = !isnan(heightCm);
+        if (!_lastValid) {
+            return;
         }
         _allSamples.add(heightCm);
-        result.meanCm = _allSamples.mean();
-        result.medianCm = _allSamples.median();
-        result.stdDevCm = _allSamples.stddev();
-        result.minCm = _allSamples.min();
-        result.maxCm = _allSamples.max();
+        _history.add(heightCm, nowSeconds);
 
         bool quietSurface = noisePercent < 3.0f;
         if (quietSurface) {
@@ -348,16 +1458,56 @@ class LevelAnalytics {
                 }
             }
         }
+    }
 
-        result.emptyEstimateCm = _emptyEstimate;
-        result.fullEstimateCm = _fullEstimate;
-        return result;
+    const LevelAnalyticsResult& result() {
+        if (_dirty) {
+            recompute();
+            _dirty = false;
+            _recomputeCount++;
+        }
+        return _result;
+    }
+
+    uint32_t recomputeCount() const {
+        return _recomputeCount;
+    }
+
+    LevelAnalyticsResult update(float heightCm, float noisePercent, uint32_t nowSeconds) {
+        add(heightCm, noisePercent, nowSeconds);
+        return result();
+    }
+
+    const DownsampleHierarchy& history() const {
+        return _history;
     }
 
   private:
-    RollingStats _allSamples;
+    void recompute() {
+        _result = LevelAnalyticsResult();
+        if (!_lastValid) {
+            return;
+        }
+        _result.meanCm = _allSamples.mean();
+        _result.medianCm = _allSamples.median();
+        _result.stdDevCm = _allSamples.stddev();
+        _result.minCm = _allSamples.min();
+        _result.maxCm = _allSamples.max();
+        BucketStats day = _history.summary(DownsampleHierarchy::Horizon::Day);
+        _result.dayMinCm = day.min;
+        _result.dayMaxCm = day.max;
+        _result.emptyEstimateCm = _emptyEstimate;
+        _result.fullEstimateCm = _fullEstimate;
+    }
+
+    FixedRollingStats<600> _allSamples;
+    DownsampleHierarchy _history;
+    LevelAnalyticsResult _result;
     float _emptyEstimate = NAN;
     float _fullEstimate = NAN;
+    bool _lastValid = false;
+    bool _dirty = true;
+    uint32_t _recomputeCount = 0;
 };
 
 }  // namespace utils
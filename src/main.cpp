@@ -1,19 +1,23 @@
 #include <Arduino.h>
 #include <SPI.h>
 #include <Wire.h>
+#include <esp_timer.h>
 #include <time.h>
 
 #include <../lib/Buttons/Buttons.h>
 #include <../lib/ConfigService/ConfigService.h>
 #include <../lib/FlowSensor/FlowSensor.h>
+#include <../lib/FlowSensor/HardwarePulseCapture.h>
 #include <../lib/Joystick/Joystick.h>
 #include <../lib/LcdUI/LcdUI.h>
+#include <../lib/LevelSensor/HardwareSampleSource.h>
 #include <../lib/LevelSensor/LevelSensor.h>
 #include <../lib/SdLogger/SdLogger.h>
+#include <../lib/StateCheckpoint/StateCheckpoint.h>
+#include <../lib/Totalizer/Totalizer.h>
 #include <../lib/Utils/Utils.h>
 #include <algorithm>
 #include <cmath>
-#include <vector>
 #include <LiquidCrystal_I2C.h>
 
 // ---- Hardware Pin Map ----
@@ -32,13 +36,42 @@ static const int PIN_SD_SCK = 18;
 
 static const uint8_t LCD_ADDRESS = 0x27;
 
+// Flow meter inputs, one PCNT unit each. Channel 0 is the primary meter that
+// feeds analytics and the totalizer; add e.g. an outlet meter's pin after it.
+static const uint8_t PIN_FLOW_SENSORS[] = {PIN_FLOW_SENSOR};
+static const size_t FLOW_CHANNEL_COUNT = sizeof(PIN_FLOW_SENSORS) / sizeof(PIN_FLOW_SENSORS[0]);
+static_assert(FLOW_CHANNEL_COUNT >= 1 && FLOW_CHANNEL_COUNT <= utils::MAX_FLOW_CHANNELS,
+              "Flow channel count must be between 1 and MAX_FLOW_CHANNELS");
+
+// Level transducers, all on ADC1 and scanned together. Channel 0 is the
+// primary tank behind the tank metrics and the checkpoint; add further tanks
+// or an inlet pressure transducer after it.
+static const uint8_t PIN_LEVEL_SENSORS[] = {PIN_LEVEL_SENSOR};
+static const size_t LEVEL_CHANNEL_COUNT = sizeof(PIN_LEVEL_SENSORS) / sizeof(PIN_LEVEL_SENSORS[0]);
+static_assert(LEVEL_CHANNEL_COUNT >= 1 && LEVEL_CHANNEL_COUNT <= utils::MAX_LEVEL_CHANNELS &&
+                  LEVEL_CHANNEL_COUNT <= ContinuousAdcScanner::MAX_CHANNELS,
+              "Level channel count must be between 1 and MAX_LEVEL_CHANNELS");
+
+// Span of the long-horizon flow baseline (P90/P10 sketch).
+static const uint32_t LONG_BASELINE_HORIZON_MS = 24UL * 60UL * 60UL * 1000UL;
+// Worst-case delay before the capture backend reports the newest edge.
+static const uint32_t FLOW_EDGE_LATENCY_US = 2UL * 1000000UL / McpwmPulseCapture::MAX_EVENTS_PER_SECOND;
+// A checkpoint is only restored if the wall clock is valid this soon after boot.
+static const uint32_t CHECKPOINT_RESTORE_WINDOW_MS = 30000;
+// Shortest spacing of the rows handed to the SD logger.
+static const uint32_t MIN_LOGGING_INTERVAL_MS = 500;
+
 // ---- Global Objects ----
-FlowSensor g_flowSensor;
-LevelSensor g_levelSensor;
+FlowSensor g_flowSensors[FLOW_CHANNEL_COUNT];
+McpwmPulseCapture g_flowCaptures[FLOW_CHANNEL_COUNT];
+ContinuousAdcScanner g_levelScanner;
+LevelSensor g_levelSensors[LEVEL_CHANNEL_COUNT];
 Buttons g_buttons;
 Joystick g_joystick;
 ConfigService g_config;
 SdLogger g_logger;
+StateCheckpoint g_checkpoint;
+Totalizer g_totalizer;
 LiquidCrystal_I2C g_lcd(LCD_ADDRESS, 16, 2);
 LcdUI g_ui;
 SPIClass g_spi(VSPI);
@@ -62,13 +95,19 @@ void applyCalibration(float actualDepthCm) {
     portENTER_CRITICAL(&g_metricsMux);
     float currentDepth = g_latestMetrics.tankHeightCm;
     portEXIT_CRITICAL(&g_metricsMux);
-    if (actualDepthCm <= 0.0f || currentDepth <= 0.0f) {
+    if (actualDepthCm <= 0.0f || isnan(currentDepth) || currentDepth <= 0.0f) {
         return;
     }
     float currentDensity = g_config.densityFactor();
     float newDensity = currentDensity * (currentDepth / actualDepthCm);
     g_config.setDensityFactor(newDensity);
-    g_levelSensor.setDensityFactor(newDensity);
+    g_levelSensors[0].setDensityFactor(newDensity);
+}
+
+void applyLevelCalibration(LevelSensor& sensor, const LevelChannelCalibration& cal) {
+    sensor.setCalibrationCurrent(cal.zeroCurrentMa, cal.fullScaleCurrentMa, cal.fullScaleHeightMm);
+    sensor.setCurrentSense(cal.senseResistorOhms, cal.senseGain);
+    sensor.setDensityFactor(cal.densityFactor);
 }
 
 void debugSdCard() {
@@ -132,18 +171,33 @@ void setup() {
     Serial.println("=============================");
 
     g_config.begin();
+    g_checkpoint.begin();
+    g_totalizer.begin();
 
     Wire.begin(PIN_LCD_SDA, PIN_LCD_SCL);
 
-    g_flowSensor.begin(PIN_FLOW_SENSOR);
-    g_levelSensor.begin(PIN_LEVEL_SENSOR, ADC_11db);
-    g_levelSensor.setOversample(g_config.levelOversampleCount());
-    g_levelSensor.setDensityFactor(g_config.densityFactor());
-    g_levelSensor.setCalibrationCurrent(g_config.zeroCurrentMa(), g_config.fullScaleCurrentMa(),
-                                       g_config.fullScaleHeightMm());
-    g_levelSensor.setCurrentSense(g_config.currentSenseResistorOhms(), g_config.currentSenseGain());
-    g_levelSensor.setFilterGains(g_config.alphaGain(), g_config.betaGain());
-    g_levelSensor.setSampleIntervalMs(g_config.sensorIntervalMs());
+    for (size_t i = 0; i < FLOW_CHANNEL_COUNT; ++i) {
+        g_flowSensors[i].begin(PIN_FLOW_SENSORS[i], &g_flowCaptures[i]);
+    }
+    g_levelScanner.setSampleRateHz(g_config.levelSampleRateHz());
+    LevelSampleSource* levelSources[LEVEL_CHANNEL_COUNT];
+    for (size_t i = 0; i < LEVEL_CHANNEL_COUNT; ++i) {
+        levelSources[i] = g_levelScanner.addChannel(PIN_LEVEL_SENSORS[i]);
+    }
+    if (!g_levelScanner.begin()) {
+        Serial.println("Level ADC scanner failed to start, polling instead");
+    }
+    for (size_t i = 0; i < LEVEL_CHANNEL_COUNT; ++i) {
+        LevelSensor& sensor = g_levelSensors[i];
+        sensor.begin(PIN_LEVEL_SENSORS[i], ADC_11db, levelSources[i]);
+        sensor.setOversample(g_config.levelOversampleCount());
+        sensor.setAdaptiveOversample(g_config.levelAdaptiveOversample(), g_config.levelOversampleMin(),
+                                     g_config.levelTargetErrorMm());
+        applyLevelCalibration(sensor, g_config.levelCalibration(i));
+        sensor.setFilterGains(g_config.alphaGain(), g_config.betaGain());
+        sensor.setKalmanFilter(g_config.levelKalmanFilter());
+        sensor.setSampleIntervalMs(g_config.sensorIntervalMs());
+    }
 
     g_buttons.begin(PIN_BUTTON_1, PIN_BUTTON_2);
     g_joystick.begin(PIN_JOYSTICK_X, PIN_JOYSTICK_Y, 0.08f);
@@ -176,29 +230,43 @@ void loop() {
 }
 
 void sensorTask(void* parameter) {
-    utils::FlowAnalytics flowAnalytics;
-    utils::LevelAnalytics levelAnalytics;
+    // Analytics windows and snapshots are far larger than the task stack.
+    static utils::FlowAnalytics flowAnalytics;
+    static utils::LevelAnalytics levelAnalytics[LEVEL_CHANNEL_COUNT];
+    static FlowSensor::Snapshot flowSnapshots[FLOW_CHANNEL_COUNT];
     TickType_t lastWake = xTaskGetTickCount();
     uint32_t intervalMs = g_config.sensorIntervalMs();
     if (intervalMs < 200) {
         intervalMs = 200;
     }
     TickType_t intervalTicks = pdMS_TO_TICKS(intervalMs);
-    g_levelSensor.setSampleIntervalMs(intervalMs);
-    g_levelSensor.setCalibrationCurrent(g_config.zeroCurrentMa(), g_config.fullScaleCurrentMa(), g_config.fullScaleHeightMm());
-    g_levelSensor.setCurrentSense(g_config.currentSenseResistorOhms(), g_config.currentSenseGain());
-    g_levelSensor.setFilterGains(g_config.alphaGain(), g_config.betaGain());
-    g_levelSensor.setDensityFactor(g_config.densityFactor());
-    FlowSensor::Snapshot initialSnapshot = g_flowSensor.takeSnapshot();
-    uint64_t previousCount = initialSnapshot.totalPulses;
-    float lastZeroCurrent = g_config.zeroCurrentMa();
-    float lastFullCurrent = g_config.fullScaleCurrentMa();
-    float lastFullHeightMm = g_config.fullScaleHeightMm();
-    float lastSenseResistor = g_config.currentSenseResistorOhms();
-    float lastSenseGain = g_config.currentSenseGain();
+    flowAnalytics.setLongHorizonSamples(LONG_BASELINE_HORIZON_MS / intervalMs);
+    LevelChannelCalibration lastCalibration[LEVEL_CHANNEL_COUNT];
+    for (size_t i = 0; i < LEVEL_CHANNEL_COUNT; ++i) {
+        lastCalibration[i] = g_config.levelCalibration(i);
+        g_levelSensors[i].setSampleIntervalMs(intervalMs);
+        applyLevelCalibration(g_levelSensors[i], lastCalibration[i]);
+        g_levelSensors[i].setFilterGains(g_config.alphaGain(), g_config.betaGain());
+    }
+    FlowSensor::takeSnapshots(g_flowSensors, FLOW_CHANNEL_COUNT, flowSnapshots);
+    uint64_t previousCounts[FLOW_CHANNEL_COUNT];
+    utils::ReciprocalFlowEstimator flowEstimators[FLOW_CHANNEL_COUNT];
+    for (size_t i = 0; i < FLOW_CHANNEL_COUNT; ++i) {
+        previousCounts[i] = flowSnapshots[i].totalPulses;
+        flowEstimators[i].setEdgeLatencyUs(FLOW_EDGE_LATENCY_US);
+    }
     float lastAlphaGain = g_config.alphaGain();
     float lastBetaGain = g_config.betaGain();
-    float lastDensity = g_config.densityFactor();
+    uint8_t lastOversample = g_config.levelOversampleCount();
+    bool lastAdaptiveOversample = g_config.levelAdaptiveOversample();
+    uint8_t lastOversampleMin = g_config.levelOversampleMin();
+    float lastTargetErrorMm = g_config.levelTargetErrorMm();
+    utils::EdgeCrossCheck edgeCheck;
+    utils::FlowAnalyticsResult flowResult;
+    utils::LevelAnalyticsResult levelResults[LEVEL_CHANNEL_COUNT];
+    TickType_t lastLogTick = xTaskGetTickCount();
+    bool restorePending = true;
+    bool levelSampled = false;
 
     while (true) {
         vTaskDelayUntil(&lastWake, intervalTicks);
@@ -207,96 +275,139 @@ void sensorTask(void* parameter) {
         if (desiredInterval != intervalMs) {
             intervalMs = desiredInterval < 200 ? 200 : desiredInterval;
             intervalTicks = pdMS_TO_TICKS(intervalMs);
-            g_levelSensor.setSampleIntervalMs(intervalMs);
+            for (LevelSensor& sensor : g_levelSensors) {
+                sensor.setSampleIntervalMs(intervalMs);
+            }
+            flowAnalytics.setLongHorizonSamples(LONG_BASELINE_HORIZON_MS / intervalMs);
         }
 
-        float zeroCurrent = g_config.zeroCurrentMa();
-        float fullCurrent = g_config.fullScaleCurrentMa();
-        float fullHeightMm = g_config.fullScaleHeightMm();
-        if (fabsf(zeroCurrent - lastZeroCurrent) > 0.001f || fabsf(fullCurrent - lastFullCurrent) > 0.001f ||
-            fabsf(fullHeightMm - lastFullHeightMm) > 0.1f) {
-            g_levelSensor.setCalibrationCurrent(zeroCurrent, fullCurrent, fullHeightMm);
-            lastZeroCurrent = zeroCurrent;
-            lastFullCurrent = fullCurrent;
-            lastFullHeightMm = fullHeightMm;
-        }
-        float senseRes = g_config.currentSenseResistorOhms();
-        float senseGain = g_config.currentSenseGain();
-        if (fabsf(senseRes - lastSenseResistor) > 0.1f || fabsf(senseGain - lastSenseGain) > 0.001f) {
-            g_levelSensor.setCurrentSense(senseRes, senseGain);
-            lastSenseResistor = senseRes;
-            lastSenseGain = senseGain;
+        for (size_t i = 0; i < LEVEL_CHANNEL_COUNT; ++i) {
+            LevelChannelCalibration calibration = g_config.levelCalibration(i);
+            if (calibration != lastCalibration[i]) {
+                applyLevelCalibration(g_levelSensors[i], calibration);
+                lastCalibration[i] = calibration;
+            }
         }
         float alphaGain = g_config.alphaGain();
         float betaGain = g_config.betaGain();
         if (fabsf(alphaGain - lastAlphaGain) > 0.0001f || fabsf(betaGain - lastBetaGain) > 0.0001f) {
-            g_levelSensor.setFilterGains(alphaGain, betaGain);
+            for (LevelSensor& sensor : g_levelSensors) {
+                sensor.setFilterGains(alphaGain, betaGain);
+            }
             lastAlphaGain = alphaGain;
             lastBetaGain = betaGain;
         }
-        float density = g_config.densityFactor();
-        if (fabsf(density - lastDensity) > 0.0001f) {
-            g_levelSensor.setDensityFactor(density);
-            lastDensity = density;
+        for (LevelSensor& sensor : g_levelSensors) {
+            sensor.setKalmanFilter(g_config.levelKalmanFilter());
+        }
+        uint8_t oversample = g_config.levelOversampleCount();
+        bool adaptiveOversample = g_config.levelAdaptiveOversample();
+        uint8_t oversampleMin = g_config.levelOversampleMin();
+        float targetErrorMm = g_config.levelTargetErrorMm();
+        if (oversample != lastOversample || adaptiveOversample != lastAdaptiveOversample ||
+            oversampleMin != lastOversampleMin || fabsf(targetErrorMm - lastTargetErrorMm) > 0.0001f) {
+            for (LevelSensor& sensor : g_levelSensors) {
+                sensor.setOversample(oversample);
+                sensor.setAdaptiveOversample(adaptiveOversample, oversampleMin, targetErrorMm);
+            }
+            lastOversample = oversample;
+            lastAdaptiveOversample = adaptiveOversample;
+            lastOversampleMin = oversampleMin;
+            lastTargetErrorMm = targetErrorMm;
         }
 
-        FlowSensor::Snapshot snapshot;
-        uint32_t deltaPulses = 0;
         float intervalSeconds = static_cast<float>(intervalMs) / 1000.0f;
-        float flowLps = NAN;
         
         // Flow sensor verilerini güvenli şekilde al
-        snapshot = g_flowSensor.takeSnapshot();
-        uint64_t deltaTotal = snapshot.totalPulses - previousCount;
-        previousCount = snapshot.totalPulses;
-        deltaPulses = static_cast<uint32_t>(deltaTotal);
-        flowLps = utils::pulsesToFlowLps(deltaPulses, intervalSeconds, g_config.pulsesPerLiter());
-
-        std::vector<float> pulsePeriodsUs;
-        pulsePeriodsUs.reserve(snapshot.periodCount);
-        for (size_t i = 0; i < snapshot.periodCount; ++i) {
-            if (snapshot.recentPeriods[i] > 0) {
-                pulsePeriodsUs.push_back(static_cast<float>(snapshot.recentPeriods[i]));
+        FlowSensor::takeSnapshots(g_flowSensors, FLOW_CHANNEL_COUNT, flowSnapshots);
+        uint32_t nowMicros = micros();
+        uint64_t channelDeltas[FLOW_CHANNEL_COUNT];
+        float channelFlows[FLOW_CHANNEL_COUNT];
+        for (size_t i = 0; i < FLOW_CHANNEL_COUNT; ++i) {
+            const FlowSensor::Snapshot& channel = flowSnapshots[i];
+            channelDeltas[i] = channel.totalPulses - previousCounts[i];
+            previousCounts[i] = channel.totalPulses;
+            uint32_t pulses = static_cast<uint32_t>(channelDeltas[i]);
+            if (g_config.reciprocalFlow() && g_flowSensors[i].capturing()) {
+                channelFlows[i] = flowEstimators[i].update(pulses, intervalSeconds, channel.periodStats.count,
+                                                           channel.periodStats.sum, nowMicros - channel.lastTimestampMicros,
+                                                           g_config.pulsesPerLiter());
+            } else {
+                channelFlows[i] = utils::pulsesToFlowLps(pulses, intervalSeconds, g_config.pulsesPerLiter());
             }
         }
 
-        float pulseMeanUs = NAN;
-        float pulseMedianUs = NAN;
-        float pulseStdUs = NAN;
+        const FlowSensor::Snapshot& snapshot = flowSnapshots[0];
+        uint32_t deltaPulses = static_cast<uint32_t>(channelDeltas[0]);
+        float flowLps = channelFlows[0];
+        g_totalizer.addPulses(channelDeltas[0], millis());
+        g_totalizer.update(millis());
+        const PeriodStatistics& periodStats = snapshot.periodStats;
+        if (g_flowSensors[0].capturing()) {
+            // One edge of read skew plus the capture path's partial group.
+            edgeCheck.update(deltaPulses, snapshot.captureEdges, snapshot.captureEdgeGranularity,
+                             snapshot.captureResynced);
+        }
+
+        float pulseMeanUs = periodStats.mean();
+        float pulseMedianUs = periodStats.median();
+        float pulseStdUs = periodStats.stddev();
         float pulseCv = NAN;
-        if (!pulsePeriodsUs.empty()) {
-            double sum = 0.0;
-            for (float value : pulsePeriodsUs) {
-                sum += value;
-            }
-            pulseMeanUs = static_cast<float>(sum / pulsePeriodsUs.size());
-            std::vector<float> sortedPeriods = pulsePeriodsUs;
-            std::sort(sortedPeriods.begin(), sortedPeriods.end());
-            if (sortedPeriods.size() % 2 == 0) {
-                pulseMedianUs = (sortedPeriods[sortedPeriods.size() / 2 - 1] +
-                                 sortedPeriods[sortedPeriods.size() / 2]) /
-                                2.0f;
-            } else {
-                pulseMedianUs = sortedPeriods[sortedPeriods.size() / 2];
-            }
-            double variance = 0.0;
-            for (float value : pulsePeriodsUs) {
-                double diff = value - pulseMeanUs;
-                variance += diff * diff;
-            }
-            variance /= pulsePeriodsUs.size();
-            pulseStdUs = static_cast<float>(sqrt(variance));
-            if (!isnan(pulseMeanUs) && fabs(pulseMeanUs) > 0.0001f) {
-                pulseCv = (pulseStdUs / pulseMeanUs) * 100.0f;
+        if (!isnan(pulseMeanUs) && fabsf(pulseMeanUs) > 0.0001f) {
+            pulseCv = (pulseStdUs / pulseMeanUs) * 100.0f;
+        }
+
+        // Warm start: wait for a valid wall clock so the checkpoint age can be
+        // judged, but only briefly after boot. A clock set later from the UI
+        // must not overwrite estimates the device has since rebuilt, so the
+        // saved state is dropped and the next save replaces it.
+        time_t wallClock = time(nullptr);
+        CheckpointPolicy::Restore restore =
+            restorePending ? CheckpointPolicy::restore(wallClock, millis(), CHECKPOINT_RESTORE_WINDOW_MS)
+                           : CheckpointPolicy::Restore::Wait;
+        if (restore == CheckpointPolicy::Restore::Drop) {
+            Serial.println("State checkpoint dropped: no wall clock after boot");
+            restorePending = false;
+        }
+        if (restore == CheckpointPolicy::Restore::Load) {
+            StateCheckpoint::Snapshot saved;
+            if (g_checkpoint.load(saved, wallClock)) {
+                flowAnalytics.restore(saved.flow);
+                levelAnalytics[0].restore(saved.level);
+                if (!levelSampled) {
+                    g_levelSensors[0].restoreFilterState(saved.levelFilter);
+                }
+                Serial.println("State checkpoint restored");
             }
+            restorePending = false;
         }
 
-        utils::FlowAnalyticsResult flowResult = flowAnalytics.update(flowLps);
+        uint32_t uptimeSeconds = static_cast<uint32_t>(esp_timer_get_time() / 1000000LL);
+        flowAnalytics.add(flowLps, uptimeSeconds);
 
         // Level sensor verilerini al (sensör bağlı değilse NaN değerleri döner)
-        utils::LevelReading levelReading = g_levelSensor.sample();
-        
-        utils::LevelAnalyticsResult levelResult = levelAnalytics.update(levelReading.heightCm, levelReading.noisePercent);
+        utils::LevelReading levelReadings[LEVEL_CHANNEL_COUNT];
+        for (size_t i = 0; i < LEVEL_CHANNEL_COUNT; ++i) {
+            levelReadings[i] = g_levelSensors[i].sample();
+            levelAnalytics[i].add(levelReadings[i].heightCm, levelReadings[i].noisePercent, uptimeSeconds);
+        }
+        levelSampled = true;
+        const utils::LevelReading& levelReading = levelReadings[0];
+
+        // Derived statistics are only evaluated on ticks whose metrics are read:
+        // the rows handed to the logger, and every tick while the LCD shows
+        // them, so a logged row always reflects this tick's samples. Other
+        // ticks publish the last computed values.
+        uint32_t loggingIntervalMs = std::max<uint32_t>(g_config.loggingIntervalMs(), MIN_LOGGING_INTERVAL_MS);
+        TickType_t nowTick = xTaskGetTickCount();
+        bool logDue = nowTick - lastLogTick >= pdMS_TO_TICKS(loggingIntervalMs);
+        if (logDue || g_ui.showsStatistics()) {
+            flowResult = flowAnalytics.result();
+            for (size_t i = 0; i < LEVEL_CHANNEL_COUNT; ++i) {
+                levelResults[i] = levelAnalytics[i].result();
+            }
+        }
+        const utils::LevelAnalyticsResult& levelResult = levelResults[0];
 
         utils::SensorMetrics metrics;
         metrics.timestamp = time(nullptr);
@@ -313,15 +424,36 @@ void sensorTask(void* parameter) {
         metrics.flowStdDevLps = flowResult.stdDevLps;
         metrics.flowMinLps = flowResult.minLps;
         metrics.flowMaxLps = flowResult.maxLps;
+        metrics.flowP25Lps = flowResult.p25Lps;
+        metrics.flowP75Lps = flowResult.p75Lps;
+        metrics.flowP99Lps = flowResult.p99Lps;
+        metrics.flowLongBaselineLps = flowResult.longBaselineLps;
+        metrics.flowLongMinHealthyLps = flowResult.longMinHealthyLps;
+        metrics.flowHourMeanLps = flowResult.hourMeanLps;
+        metrics.flowDayMeanLps = flowResult.dayMeanLps;
         metrics.flowPulseMeanUs = pulseMeanUs;
         metrics.flowPulseMedianUs = pulseMedianUs;
         metrics.flowPulseStdUs = pulseStdUs;
         metrics.flowPulseCv = pulseCv;
-        metrics.flowPeriodCount = pulsePeriodsUs.size();
-        for (size_t i = 0; i < utils::MAX_FLOW_PERIOD_SAMPLES && i < pulsePeriodsUs.size(); ++i) {
-            metrics.flowRecentPeriods[i] = static_cast<uint32_t>(pulsePeriodsUs[i]);
+        metrics.flowPeriodCount = snapshot.periodCount;
+        metrics.flowIntervalPeriods = periodStats.count;
+        for (size_t i = 0; i < utils::MAX_FLOW_PERIOD_SAMPLES && i < snapshot.periodCount; ++i) {
+            metrics.flowRecentPeriods[i] = snapshot.recentPeriods[i];
+        }
+        metrics.pumpOn = flowAnalytics.pumpOn();
+        metrics.flowCaptureEdges = snapshot.captureEdges;
+        metrics.flowEdgeDelta = edgeCheck.intervalDelta;
+        metrics.flowEdgeDeltaTotal = edgeCheck.cumulativeDelta;
+        metrics.flowGlitchRejects = edgeCheck.glitchRejections;
+        metrics.flowMissedEdges = edgeCheck.missedEdges;
+        metrics.flowChannelCount = static_cast<uint8_t>(FLOW_CHANNEL_COUNT);
+        for (size_t i = 0; i < FLOW_CHANNEL_COUNT; ++i) {
+            metrics.channelPulseCount[i] = static_cast<uint32_t>(channelDeltas[i]);
+            metrics.channelFlowLps[i] = channelFlows[i];
         }
-        metrics.pumpOn = flowResult.pumpOn;
+        metrics.totalPulses = g_totalizer.totalPulses();
+        metrics.totalVolumeLiters = g_totalizer.totalLiters(g_config.pulsesPerLiter());
+        metrics.totalVolumeUncertaintyLiters = g_totalizer.uncertaintyLiters(g_config.pulsesPerLiter());
 
         metrics.tankHeightCm = levelReading.heightCm;
         metrics.tankEmptyEstimateCm = levelResult.emptyEstimateCm;
@@ -335,6 +467,8 @@ void sensorTask(void* parameter) {
         metrics.tankStdDevCm = levelResult.stdDevCm;
         metrics.tankMinObservedCm = levelResult.minCm;
         metrics.tankMaxObservedCm = levelResult.maxCm;
+        metrics.tankDayMinCm = levelResult.dayMinCm;
+        metrics.tankDayMaxCm = levelResult.dayMaxCm;
         metrics.levelVoltage = levelReading.voltage;
         metrics.levelAverageVoltage = levelReading.averageVoltage;
         metrics.levelMedianVoltage = levelReading.medianVoltage;
@@ -346,15 +480,37 @@ void sensorTask(void* parameter) {
         metrics.levelRawHeightCm = levelReading.rawHeightCm;
         metrics.levelFilteredHeightCm = levelReading.filteredHeightCm;
         metrics.levelAlphaBetaVelocity = levelReading.alphaBetaVelocity;
+        metrics.levelSampleCount = levelReading.sampleCount;
+        metrics.levelEstimateVarianceMm2 = levelReading.depthVarianceMm2;
+        metrics.levelInnovationMm = levelReading.innovationMm;
         metrics.densityFactor = g_config.densityFactor();
+        metrics.levelChannelCount = static_cast<uint8_t>(LEVEL_CHANNEL_COUNT);
+        for (size_t i = 0; i < LEVEL_CHANNEL_COUNT; ++i) {
+            metrics.channelTankHeightCm[i] = levelReadings[i].heightCm;
+            metrics.channelLevelCurrentMa[i] = levelReadings[i].currentMilliAmps;
+            metrics.channelTankNoisePercent[i] = levelReadings[i].noisePercent;
+            metrics.channelTankMeanCm[i] = levelResults[i].meanCm;
+            metrics.channelTankStdDevCm[i] = levelResults[i].stdDevCm;
+            metrics.channelTankEmptyEstimateCm[i] = levelResults[i].emptyEstimateCm;
+            metrics.channelTankFullEstimateCm[i] = levelResults[i].fullEstimateCm;
+        }
 
         portENTER_CRITICAL(&g_metricsMux);
         g_latestMetrics = metrics;
         g_metricsAvailable = true;
         portEXIT_CRITICAL(&g_metricsMux);
 
-        if (g_loggerQueue) {
+        if (logDue && g_loggerQueue) {
             xQueueSend(g_loggerQueue, &metrics, 0);
+            lastLogTick = nowTick;
+        }
+
+        if (!restorePending && g_checkpoint.saveDue(millis())) {
+            StateCheckpoint::Snapshot checkpoint;
+            checkpoint.flow = flowAnalytics.state();
+            checkpoint.level = levelAnalytics[0].state();
+            checkpoint.levelFilter = g_levelSensors[0].filterState();
+            g_checkpoint.save(checkpoint, wallClock);
         }
 
         // Debug sensor değerleri (sadece 10 saniyede bir yazdır, spam olmasın)
@@ -399,27 +555,13 @@ void uiTask(void* parameter) {
 }
 
 void loggerTask(void* parameter) {
+    // sensorTask only queues the rows due for logging, each with statistics
+    // computed on its own tick.
     utils::SensorMetrics metrics;
-    utils::SensorMetrics latest;
-    bool haveLatest = false;
-    TickType_t lastLogTick = xTaskGetTickCount();
     while (true) {
-        if (g_loggerQueue && xQueueReceive(g_loggerQueue, &metrics, pdMS_TO_TICKS(1000)) == pdTRUE) {
-            latest = metrics;
-            haveLatest = true;
-        }
-        uint32_t intervalMs = g_config.loggingIntervalMs();
-        if (intervalMs < 500) {
-            intervalMs = 500;
-        }
-        TickType_t now = xTaskGetTickCount();
-        if (haveLatest && now - lastLogTick >= pdMS_TO_TICKS(intervalMs)) {
-            g_logger.log(latest);
-            lastLogTick = now;
-            haveLatest = false;
+        if (g_loggerQueue && xQueueReceive(g_loggerQueue, &metrics, pdMS_TO_TICKS(200)) == pdTRUE) {
+            g_logger.log(metrics);
         }
         g_logger.update();
-        vTaskDelay(pdMS_TO_TICKS(200));
     }
 }
-
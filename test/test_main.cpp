@@ -1,6 +1,17 @@
 #include <Arduino.h>
 #include <unity.h>
 
+#include <FlowSensor/OverflowCounter.h>
+#include <FlowSensor/PulseCapture.h>
+#include <FlowSensor/UnitAllocator.h>
+#include <LevelSensor/AdcFrameSplitter.h>
+#include <LevelSensor/AdcVoltageTable.h>
+#include <LevelSensor/DecimationFilter.h>
+#include <LevelSensor/LevelSampleSource.h>
+#include <LevelSensor/LevelSensor.h>
+#include <LevelSensor/SampleReduction.h>
+#include <StateCheckpoint/CheckpointBlob.h>
+#include <Totalizer/TotalizerRecord.h>
 #include <Utils/Utils.h>
 
 void test_pulses_to_flow() {
@@ -13,11 +24,755 @@ void test_voltage_to_height() {
     TEST_ASSERT_FLOAT_WITHIN(1.0f, 250.0f, height);
 }
 
+void test_rolling_percentile_matches_sorted() {
+    utils::RollingStats stats(25);
+    std::vector<float> window;
+    for (int i = 0; i < 200; ++i) {
+        float value = static_cast<float>((i * 37) % 101) / 10.0f;
+        stats.add(value);
+        window.push_back(value);
+        if (window.size() > 25) {
+            window.erase(window.begin());
+        }
+    }
+    std::vector<float> sorted = window;
+    std::sort(sorted.begin(), sorted.end());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, sorted.front(), stats.percentile(0.0f));
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, sorted[12], stats.median());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, sorted[21] + (sorted[22] - sorted[21]) * 0.6f, stats.percentile(90.0f));
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, sorted.back(), stats.percentile(100.0f));
+}
+
+void test_rolling_quantiles_match_single_calls() {
+    const float percents[] = {100.0f, 0.0f, 37.5f, 50.0f, 90.0f};
+    utils::RollingStats stats(25);
+    std::vector<float> window;
+    for (int i = 0; i < 60; ++i) {
+        float value = static_cast<float>((i * 53) % 97) / 4.0f;
+        stats.add(value);
+        window.push_back(value);
+        if (window.size() > 25) {
+            window.erase(window.begin());
+        }
+    }
+    std::vector<float> sorted = window;
+    std::sort(sorted.begin(), sorted.end());
+    std::array<float, 5> batch = stats.quantiles(percents);
+    for (size_t i = 0; i < 5; ++i) {
+        TEST_ASSERT_FLOAT_WITHIN(0.0001f, stats.percentile(percents[i]), batch[i]);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, sorted.back(), batch[0]);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, sorted.front(), batch[1]);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, sorted[9], batch[2]);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, sorted[12], batch[3]);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, sorted[21] + (sorted[22] - sorted[21]) * 0.6f, batch[4]);
+
+    utils::RollingStats single(25);
+    single.add(3.25f);
+    std::array<float, 5> lone = single.quantiles(percents);
+    for (float value : lone) {
+        TEST_ASSERT_FLOAT_WITHIN(0.0001f, 3.25f, value);
+    }
+}
+
+// Counts heap allocations so fixed-capacity storage can be checked.
+static size_t g_heapAllocations = 0;
+
+void* operator new(size_t size) {
+    ++g_heapAllocations;
+    void* block = malloc(size == 0 ? 1 : size);
+    if (block == nullptr) {
+        abort();
+    }
+    return block;
+}
+
+void operator delete(void* block) noexcept {
+    free(block);
+}
+
+void test_fixed_rolling_stats_wraps_without_allocating() {
+    size_t allocationsBefore = g_heapAllocations;
+    utils::FixedRollingStats<8> stats;
+    for (int i = 0; i < 8; ++i) {
+        stats.add(static_cast<float>(i));
+    }
+    TEST_ASSERT_EQUAL_UINT32(8, stats.size());
+    // Two adds past capacity evict 0 and then 1, oldest first.
+    stats.add(8.0f);
+    stats.add(9.0f);
+    TEST_ASSERT_EQUAL_UINT32(8, stats.size());
+    TEST_ASSERT_EQUAL_UINT32(8, stats.capacity());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 2.0f, stats.at(0));
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 9.0f, stats.at(7));
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 2.0f, stats.min());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 5.5f, stats.median());
+    for (int i = 10; i < 100; ++i) {
+        stats.add(static_cast<float>(i));
+    }
+    TEST_ASSERT_EQUAL_UINT32(8, stats.size());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 92.0f, stats.at(0));
+    TEST_ASSERT_EQUAL_UINT32(allocationsBefore, g_heapAllocations);
+}
+
+void test_rolling_min_max_follow_evictions() {
+    utils::RollingStats stats(5);
+    const float values[] = {1.0f, 9.0f, 5.0f, 6.0f, 7.0f};
+    for (float value : values) {
+        stats.add(value);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 1.0f, stats.min());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 9.0f, stats.max());
+    stats.add(8.0f);  // evicts the minimum
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 5.0f, stats.min());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 9.0f, stats.max());
+    stats.add(4.0f);  // evicts the maximum
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 4.0f, stats.min());
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 8.0f, stats.max());
+
+    std::vector<float> window;
+    uint32_t seed = 99;
+    for (int i = 0; i < 500; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        float value = static_cast<float>(seed >> 24);  // repeats exercise ties
+        stats.add(value);
+        window.push_back(value);
+        if (window.size() > 5) {
+            window.erase(window.begin());
+        }
+        if (window.size() == 5) {
+            TEST_ASSERT_FLOAT_WITHIN(0.0001f, *std::min_element(window.begin(), window.end()), stats.min());
+            TEST_ASSERT_FLOAT_WITHIN(0.0001f, *std::max_element(window.begin(), window.end()), stats.max());
+        }
+    }
+}
+
+void test_quantile_sketch_within_error_bound() {
+    utils::QuantileSketch<128> sketch(0.05f, 100.0f, 1000000);
+    utils::RollingStats exact(2000);
+    for (int i = 0; i < 2000; ++i) {
+        float value = 0.5f + static_cast<float>((i * 7919) % 2000) / 400.0f;
+        sketch.add(value);
+        exact.add(value);
+    }
+    float bound = sketch.relativeErrorPercent() / 100.0f;
+    float p90 = exact.percentile(90.0f);
+    float p10 = exact.percentile(10.0f);
+    TEST_ASSERT_FLOAT_WITHIN(p90 * bound + 0.01f, p90, sketch.quantile(90.0f));
+    TEST_ASSERT_FLOAT_WITHIN(p10 * bound + 0.01f, p10, sketch.quantile(10.0f));
+}
+
+void test_quantile_sketch_clamps_small_horizon() {
+    // A horizon below 2 * BINS used to make add() and merge() spin forever.
+    utils::QuantileSketch<16> sketch(0.05f, 100.0f, 1);
+    utils::QuantileSketch<16> source(0.05f, 100.0f, 1000000);
+    for (int i = 0; i < 100; ++i) {
+        float value = 0.1f + static_cast<float>(i);
+        sketch.add(value);
+        source.add(value);
+    }
+    TEST_ASSERT_TRUE(sketch.count() < 32);
+    sketch.merge(source.bins());
+    TEST_ASSERT_TRUE(sketch.count() < 32);
+    TEST_ASSERT_FALSE(isnan(sketch.quantile(50.0f)));
+}
+
+void test_float_kernels_match_double_reference() {
+    utils::RollingStats stats(600);
+    PeriodStatsBank periods;
+    double sum = 0.0;
+    double sumSquares = 0.0;
+    std::vector<double> window;
+    uint32_t seed = 12345;
+    for (int i = 0; i < 5000; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        float value = 250.0f + static_cast<float>(seed >> 8) / 16777216.0f * 0.2f;
+        stats.add(value);
+        window.push_back(value);
+        if (window.size() > 600) {
+            window.erase(window.begin());
+        }
+        uint32_t period = 8000 + (seed >> 20);
+        periods.record(period);
+        sum += period;
+        sumSquares += static_cast<double>(period) * period;
+    }
+    double windowMean = 0.0;
+    for (double v : window) {
+        windowMean += v;
+    }
+    windowMean /= window.size();
+    double windowM2 = 0.0;
+    for (double v : window) {
+        windowM2 += (v - windowMean) * (v - windowMean);
+    }
+    double windowStd = sqrt(windowM2 / (window.size() - 1));
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, static_cast<float>(windowMean), stats.mean());
+    TEST_ASSERT_FLOAT_WITHIN(static_cast<float>(windowStd) * 1e-3f, static_cast<float>(windowStd), stats.stddev());
+
+    PeriodStatistics periodStats;
+    periods.take(periodStats);
+    double periodMean = sum / 5000.0;
+    double periodStd = sqrt(sumSquares / 5000.0 - periodMean * periodMean);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, static_cast<float>(periodMean), periodStats.mean());
+    TEST_ASSERT_FLOAT_WITHIN(static_cast<float>(periodStd) * 1e-4f, static_cast<float>(periodStd), periodStats.stddev());
+
+    // Small spread on a long period, where the naive formula cancels to zero.
+    for (int i = 0; i < 1000; ++i) {
+        periods.record(i % 2 == 0 ? 99990 : 100010);
+    }
+    periods.take(periodStats);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 10.0f, periodStats.stddev());
+}
+
+void test_downsample_horizons_roll_over() {
+    // One sample per minute, valued by its minute index, for 25 h 10 min.
+    static utils::DownsampleHierarchy history;
+    for (uint32_t minute = 0; minute < 1510; ++minute) {
+        history.add(static_cast<float>(minute), minute * 60);
+    }
+    utils::BucketStats hour = history.summary(utils::DownsampleHierarchy::Horizon::Hour);
+    TEST_ASSERT_EQUAL_UINT32(60, hour.count);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 1450.0f, hour.min);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 1509.0f, hour.max);
+    // 23 closed hours (hours 2..24), the open hour so far and the open minute.
+    utils::BucketStats day = history.summary(utils::DownsampleHierarchy::Horizon::Day);
+    TEST_ASSERT_EQUAL_UINT32(23 * 60 + 10, day.count);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 120.0f, day.min);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 1509.0f, day.max);
+    utils::BucketStats week = history.summary(utils::DownsampleHierarchy::Horizon::Week);
+    TEST_ASSERT_EQUAL_UINT32(1510, week.count);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 754.5f, week.mean());
+}
+
+static TotalizerRecord makeTotalizerRecord(uint32_t sequence) {
+    TotalizerRecord record{};
+    record.sequence = sequence;
+    record.totalPulses = 1000ULL * sequence;
+    record.seal();
+    return record;
+}
+
+void test_totalizer_records_rotate_over_slots() {
+    bool used[TotalizerRecord::SLOT_COUNT] = {};
+    for (uint32_t sequence = 41; sequence < 41 + TotalizerRecord::SLOT_COUNT; ++sequence) {
+        uint8_t slot = TotalizerRecord::slotFor(sequence);
+        TEST_ASSERT_FALSE(used[slot]);
+        used[slot] = true;
+    }
+    // The rotation carries on in order across the sequence wrap.
+    TEST_ASSERT_EQUAL_UINT8(TotalizerRecord::SLOT_COUNT - 1, TotalizerRecord::slotFor(0xFFFFFFFFu));
+    TEST_ASSERT_EQUAL_UINT8(0, TotalizerRecord::slotFor(0));
+}
+
+void test_totalizer_recovers_past_corrupt_newest_slot() {
+    TotalizerRecord slots[TotalizerRecord::SLOT_COUNT];
+    for (uint32_t sequence = 10; sequence < 18; ++sequence) {
+        slots[TotalizerRecord::slotFor(sequence)] = makeTotalizerRecord(sequence);
+    }
+    // Torn write: the newest record's tail never reached flash.
+    slots[TotalizerRecord::slotFor(17)].uncertaintyPulses = 0xFFFFFFFFFFFFFFFFULL;
+    // Bit flip in the one before it.
+    slots[TotalizerRecord::slotFor(16)].totalPulses ^= 4;
+    TotalizerRecordSelector selector;
+    for (const TotalizerRecord& record : slots) {
+        selector.offer(record);
+    }
+    TEST_ASSERT_TRUE(selector.found());
+    TEST_ASSERT_EQUAL_UINT32(15, selector.newest().sequence);
+    TEST_ASSERT_TRUE(selector.newest().totalPulses == 15000ULL);
+
+    TotalizerRecordSelector empty;
+    TotalizerRecord blank{};
+    blank.crc = 1;
+    empty.offer(blank);
+    TEST_ASSERT_FALSE(empty.found());
+}
+
+void test_totalizer_recovers_across_sequence_wrap() {
+    TotalizerRecord slots[TotalizerRecord::SLOT_COUNT];
+    for (uint32_t i = 0; i < TotalizerRecord::SLOT_COUNT; ++i) {
+        uint32_t sequence = 0xFFFFFFFCu + i;  // ...FFFC to 0x3
+        slots[TotalizerRecord::slotFor(sequence)] = makeTotalizerRecord(sequence);
+    }
+    TotalizerRecordSelector selector;
+    for (const TotalizerRecord& record : slots) {
+        selector.offer(record);
+    }
+    TEST_ASSERT_EQUAL_UINT32(3, selector.newest().sequence);
+}
+
+void test_analytics_recompute_only_when_changed() {
+    static utils::FlowAnalytics flow;
+    static utils::LevelAnalytics level;
+    for (uint32_t i = 0; i < 10; ++i) {
+        flow.add(1.0f + static_cast<float>(i) * 0.1f, i);
+        level.add(100.0f + static_cast<float>(i), 1.0f, i);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, flow.recomputeCount());
+    float mean = flow.result().meanLps;
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.45f, mean);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 104.5f, level.result().meanCm);
+    flow.result();
+    level.result();
+    TEST_ASSERT_EQUAL_UINT32(1, flow.recomputeCount());
+    TEST_ASSERT_EQUAL_UINT32(1, level.recomputeCount());
+
+    flow.add(2.0f, 10);
+    level.add(110.0f, 1.0f, 10);
+    TEST_ASSERT_EQUAL_UINT32(1, flow.recomputeCount());
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.5f, flow.result().meanLps);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 105.0f, level.result().meanCm);
+    TEST_ASSERT_EQUAL_UINT32(2, flow.recomputeCount());
+    TEST_ASSERT_EQUAL_UINT32(2, level.recomputeCount());
+}
+
+void test_flow_state_round_trip() {
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926u, utils::crc32("123456789", 9));
+
+    utils::FlowAnalytics before;
+    for (uint32_t i = 0; i < 2000; ++i) {
+        before.add(1.0f + static_cast<float>(i % 50) * 0.02f, i);
+    }
+    utils::FlowAnalytics::State saved = before.state();
+
+    utils::FlowAnalytics after;
+    after.restore(saved);
+    after.add(1.5f, 0);
+    TEST_ASSERT_FLOAT_WITHIN(before.result().longBaselineLps * 0.05f, before.result().longBaselineLps,
+                             after.result().longBaselineLps);
+}
+
+struct TestCheckpointState {
+    float level;
+    uint32_t pulses;
+};
+
+void test_checkpoint_blob_rejects_bad_saves() {
+    typedef CheckpointBlob<TestCheckpointState> Blob;
+    const time_t savedAt = 1700000000;
+    const uint32_t maxAge = 6 * 3600;
+    Blob sealed{};
+    sealed.seal(3, savedAt, TestCheckpointState{12.5f, 42});
+    TEST_ASSERT_TRUE(sealed.check(3, savedAt + maxAge, maxAge) == Blob::Status::Ok);
+
+    TEST_ASSERT_TRUE(sealed.check(4, savedAt, maxAge) == Blob::Status::WrongVersion);
+    Blob resized = sealed;
+    resized.size -= 4;
+    TEST_ASSERT_TRUE(resized.check(3, savedAt, maxAge) == Blob::Status::WrongSize);
+    Blob corrupt = sealed;
+    corrupt.snapshot.pulses ^= 1;
+    TEST_ASSERT_TRUE(corrupt.check(3, savedAt, maxAge) == Blob::Status::Corrupt);
+    TEST_ASSERT_TRUE(sealed.check(3, savedAt - 1, maxAge) == Blob::Status::FromFuture);
+    TEST_ASSERT_TRUE(sealed.check(3, savedAt + maxAge + 1, maxAge) == Blob::Status::Expired);
+}
+
+void test_checkpoint_policy_limits_saves_and_restores() {
+    TEST_ASSERT_FALSE(CheckpointPolicy::saveDue(900999, 1000, 900000));
+    TEST_ASSERT_TRUE(CheckpointPolicy::saveDue(901000, 1000, 900000));
+    TEST_ASSERT_TRUE(CheckpointPolicy::saveDue(0x100, 0xFFFFF000u, 0x1000));  // across the millis() wrap
+
+    const time_t unset = 5;
+    const time_t valid = 1700000000;
+    TEST_ASSERT_TRUE(CheckpointPolicy::restore(unset, 1000, 30000) == CheckpointPolicy::Restore::Wait);
+    TEST_ASSERT_TRUE(CheckpointPolicy::restore(valid, 1000, 30000) == CheckpointPolicy::Restore::Load);
+    TEST_ASSERT_TRUE(CheckpointPolicy::restore(unset, 30001, 30000) == CheckpointPolicy::Restore::Drop);
+    // A clock set late, e.g. from the UI, must not bring back stale state.
+    TEST_ASSERT_TRUE(CheckpointPolicy::restore(valid, 30001, 30000) == CheckpointPolicy::Restore::Drop);
+}
+
+void test_synthetic_capture_drains_newest_periods() {
+    SyntheticPulseCapture capture;
+    capture.begin(0);
+    capture.feedTrain(100.0f, 10);
+    capture.feedTrain(2000.0f, 100, 1.0f);
+    uint32_t periods[16];
+    TEST_ASSERT_EQUAL_UINT32(16, capture.drain(periods, 16));
+    for (size_t i = 0; i < 16; ++i) {
+        TEST_ASSERT_UINT32_WITHIN(5, 500, periods[i]);
+    }
+    TEST_ASSERT_EQUAL_UINT32(110 - SyntheticPulseCapture::CAPACITY, capture.droppedPeriods());
+    TEST_ASSERT_EQUAL_UINT32(0, capture.drain(periods, 16));
+}
+
+void test_period_statistics_cover_every_pulse() {
+    SyntheticPulseCapture capture;
+    capture.begin(0);
+    capture.feedTrain(1000.0f, 10000, 10.0f);
+    PeriodStatistics stats;
+    capture.takeStatistics(stats);
+    TEST_ASSERT_EQUAL_UINT32(10000, stats.count);
+    TEST_ASSERT_FLOAT_WITHIN(5.0f, 1000.0f, stats.mean());
+    TEST_ASSERT_FLOAT_WITHIN(1000.0f / 16.0f, 1000.0f, stats.median());
+    TEST_ASSERT_FLOAT_WITHIN(5.0f, 100.0f / sqrtf(3.0f), stats.stddev());
+    TEST_ASSERT_TRUE(stats.min >= 900 && stats.max <= 1100);
+
+    capture.takeStatistics(stats);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.count);
+}
+
+void test_reciprocal_flow_estimator() {
+    utils::ReciprocalFlowEstimator estimator;
+    // Two 400 ms periods inside a 1 s window: 2.5 Hz, not the 2 Hz count.
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 2.5f / 12.0f, estimator.update(2, 1.0f, 2, 800000, 100000, 12.0f));
+    TEST_ASSERT_TRUE(estimator.usedReciprocal());
+    // No edge for 1.25 s: bounded to 0.8 Hz rather than holding 2.5 Hz.
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 0.8f / 12.0f, estimator.update(0, 1.0f, 0, 0, 1250000, 12.0f));
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.0f, estimator.update(0, 1.0f, 0, 0, 20000000, 12.0f));
+    // High rates fall back to count / interval.
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 500.0f / 12.0f, estimator.update(500, 1.0f, 480, 1000000, 1000, 12.0f));
+    TEST_ASSERT_TRUE(!estimator.usedReciprocal());
+}
+
+void test_overflow_counter_folds_wraps() {
+    OverflowCounter counter(100);
+    TEST_ASSERT_EQUAL_UINT32(40, static_cast<uint32_t>(counter.total(40)));
+    counter.onOverflow();
+    TEST_ASSERT_EQUAL_UINT32(130, static_cast<uint32_t>(counter.total(30)));
+    // Wrapped again but the ISR has not run yet: no step backwards.
+    TEST_ASSERT_EQUAL_UINT32(205, static_cast<uint32_t>(counter.total(5)));
+    counter.onOverflow();
+    TEST_ASSERT_EQUAL_UINT32(210, static_cast<uint32_t>(counter.total(10)));
+    for (uint32_t i = 0; i < 100000; ++i) {
+        counter.onOverflow();
+    }
+    TEST_ASSERT_TRUE(counter.total(0) == 100000ULL * 100ULL + 200ULL);
+}
+
+void test_unit_allocator_hands_out_each_unit_once() {
+    UnitAllocator allocator(8);
+    uint32_t unit = 0;
+    for (uint32_t expected = 0; expected < 8; ++expected) {
+        TEST_ASSERT_TRUE(allocator.claim(unit));
+        TEST_ASSERT_EQUAL_UINT32(expected, unit);
+    }
+    TEST_ASSERT_FALSE(allocator.claim(unit));
+
+    // A released unit is reused first; the others stay claimed.
+    allocator.release(5);
+    allocator.release(2);
+    TEST_ASSERT_FALSE(allocator.inUse(2));
+    TEST_ASSERT_TRUE(allocator.inUse(3));
+    TEST_ASSERT_TRUE(allocator.claim(unit));
+    TEST_ASSERT_EQUAL_UINT32(2, unit);
+    TEST_ASSERT_TRUE(allocator.claim(unit));
+    TEST_ASSERT_EQUAL_UINT32(5, unit);
+    TEST_ASSERT_FALSE(allocator.claim(unit));
+
+    allocator.release(8);
+    TEST_ASSERT_FALSE(allocator.claim(unit));
+}
+
+void test_overflow_counter_retries_across_isr() {
+    OverflowCounter counter(32000);
+    TEST_ASSERT_EQUAL_UINT32(31990, static_cast<uint32_t>(counter.total(31990)));
+    // The ISR fires between the pre-wrap counter read and the event count.
+    int reads = 0;
+    uint64_t total = counter.read([&counter, &reads]() -> int16_t {
+        if (reads++ == 0) {
+            counter.onOverflow();
+            return 31999;
+        }
+        return 5;
+    });
+    TEST_ASSERT_EQUAL_INT(2, reads);
+    TEST_ASSERT_EQUAL_UINT32(32005, static_cast<uint32_t>(total));
+    TEST_ASSERT_EQUAL_UINT32(32100, static_cast<uint32_t>(counter.total(100)));
+
+    // Wrapped with the ISR pending for several reads: credited once, not per read.
+    TEST_ASSERT_EQUAL_UINT32(63990, static_cast<uint32_t>(counter.total(31990)));
+    TEST_ASSERT_EQUAL_UINT32(64003, static_cast<uint32_t>(counter.total(3)));
+    TEST_ASSERT_EQUAL_UINT32(64010, static_cast<uint32_t>(counter.total(10)));
+    counter.onOverflow();
+    TEST_ASSERT_EQUAL_UINT32(64020, static_cast<uint32_t>(counter.total(20)));
+    TEST_ASSERT_EQUAL_UINT32(64030, static_cast<uint32_t>(counter.total(30)));
+}
+
+void test_edge_cross_check_splits_divergence() {
+    SyntheticPulseCapture capture;
+    capture.begin(0);
+    uint32_t before = capture.edgeCount();
+    capture.feedTrain(50.0f, 40);
+    uint32_t edges = capture.edgeCount() - before;
+    TEST_ASSERT_EQUAL_UINT32(40, edges);
+
+    utils::EdgeCrossCheck check;
+    // Read skew between the two counters wobbles without counting.
+    for (int i = 0; i < 50; ++i) {
+        check.update(100, i % 2 == 0 ? 101 : 99);
+    }
+    TEST_ASSERT_TRUE(check.cumulativeDelta == 0);
+    TEST_ASSERT_TRUE(check.glitchRejections == 0 && check.missedEdges == 0);
+
+    check.update(100, 95);
+    TEST_ASSERT_TRUE(check.intervalDelta == -5);
+    TEST_ASSERT_TRUE(check.missedEdges == 5);
+    // A prescaled path trailing by a partial group stays inside its band.
+    check.update(100, 104, 4);
+    check.update(100, 96, 4);
+    TEST_ASSERT_TRUE(check.missedEdges == 5 && check.glitchRejections == 0);
+    // Edges lost to a capture reconfiguration are not attributed.
+    check.update(100, 60, 4, true);
+    check.update(100, 100);
+    TEST_ASSERT_TRUE(check.missedEdges == 5);
+    TEST_ASSERT_TRUE(check.cumulativeDelta == -45);
+    check.update(38, 41);
+    TEST_ASSERT_TRUE(check.glitchRejections == 3);
+}
+
+void test_level_samples_reduce_since_last_read() {
+    SyntheticSampleSource source;
+    source.begin(32);
+    source.feedNoise(2000, 40, 100);
+    uint16_t raw[64];
+    TEST_ASSERT_EQUAL_UINT32(64, source.read(raw, 64));
+    TEST_ASSERT_EQUAL_UINT32(0, source.read(raw, 64));
+
+    float values[10] = {1.0f, 9.0f, 2.0f, 8.0f, 3.0f, 7.0f, 4.0f, 6.0f, 5.0f, 100.0f};
+    SampleSummary summary = reduceSamples(values, 10);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 14.5f, summary.mean);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 5.5f, summary.median);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 5.5f, summary.trimmedMean);
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 100.0f, summary.last);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 28.6051f, summary.standardDeviation);
+}
+
+void test_level_reading_without_samples_is_missing() {
+    static SyntheticSampleSource source;
+    static LevelSensor sensor;
+    sensor.begin(32, ADC_11db, &source);
+    source.feedNoise(2000, 2, 20);
+    utils::LevelReading reading = sensor.sample();
+    TEST_ASSERT_FALSE(isnan(reading.heightCm));
+    TEST_ASSERT_TRUE(reading.heightCm > 0.0f);
+
+    utils::LevelReading empty = sensor.sample();
+    TEST_ASSERT_EQUAL_UINT32(0, empty.sampleCount);
+    TEST_ASSERT_TRUE(isnan(empty.heightCm));
+    TEST_ASSERT_TRUE(isnan(empty.depthMillimeters));
+    TEST_ASSERT_TRUE(isnan(empty.noisePercent));
+
+    utils::LevelAnalytics analytics;
+    analytics.add(reading.heightCm, reading.noisePercent, 0);
+    analytics.add(empty.heightCm, empty.noisePercent, 1);
+    utils::LevelAnalyticsResult result = analytics.result();
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, reading.heightCm, result.minCm);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, reading.heightCm, result.emptyEstimateCm);
+}
+
+void test_sample_reduction_matches_sorted_reference() {
+    std::vector<float> values;
+    for (size_t count = 1; count <= 64; ++count) {
+        values.clear();
+        for (size_t i = 0; i < count; ++i) {
+            values.push_back(1.0f + static_cast<float>((i * 37 + count * 11) % 53) * 0.01f);
+        }
+        std::vector<float> sorted = values;
+        std::sort(sorted.begin(), sorted.end());
+        float median = (count % 2 == 0) ? (sorted[count / 2 - 1] + sorted[count / 2]) / 2.0f : sorted[count / 2];
+        size_t trim = std::max<size_t>(1, count / 10);
+        float trimmedMean = 0.0f;
+        if (count > 2 * trim) {
+            for (size_t i = trim; i < count - trim; ++i) {
+                trimmedMean += sorted[i];
+            }
+            trimmedMean /= static_cast<float>(count - 2 * trim);
+        }
+
+        SampleSummary summary = reduceSamples(values.data(), count);
+        TEST_ASSERT_FLOAT_WITHIN(0.0001f, median, summary.median);
+        if (count > 2 * trim) {
+            TEST_ASSERT_FLOAT_WITHIN(0.0001f, trimmedMean, summary.trimmedMean);
+        }
+    }
+}
+
+void test_voltage_table_interpolates_fraction_bits() {
+    // Bent transfer curve: 1 mV per code up to 2048, 0.5 mV per code above.
+    static AdcVoltageTable table;
+    table.build([](uint32_t code) { return code <= 2048 ? static_cast<float>(code) : 2048.0f + (code - 2048) * 0.5f; });
+
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 0.100f, table.toVolts(100 << AdcVoltageTable::FRACTION_BITS));
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 0.10025f, table.toVolts((100 << AdcVoltageTable::FRACTION_BITS) + 4));
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 2.52425f, table.toVolts((3000 << AdcVoltageTable::FRACTION_BITS) + 8));
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 3.0715f, table.toVolts(UINT16_MAX));
+}
+
+void test_oversample_meets_standard_error_target() {
+    // sigma 4 mm, target 1 mm -> 16 samples.
+    TEST_ASSERT_EQUAL_UINT32(16, oversampleForStandardError(4.0f, 1.0f, 5, 64));
+    TEST_ASSERT_EQUAL_UINT32(17, oversampleForStandardError(4.1f, 1.0f, 5, 64));
+    TEST_ASSERT_EQUAL_UINT32(5, oversampleForStandardError(0.0f, 1.0f, 5, 64));
+    TEST_ASSERT_EQUAL_UINT32(64, oversampleForStandardError(20.0f, 1.0f, 5, 64));
+    TEST_ASSERT_EQUAL_UINT32(64, oversampleForStandardError(NAN, 1.0f, 5, 64));
+}
+
+// 20 kHz conversions of a 2000-count level with 50 Hz slosh of ±200 counts.
+static void fillSloshBlock(uint16_t* block, size_t count, uint32_t& sampleIndex) {
+    for (size_t i = 0; i < count; ++i, ++sampleIndex) {
+        float phase = 2.0f * 3.14159265f * 50.0f * static_cast<float>(sampleIndex % 400) / 20000.0f;
+        block[i] = static_cast<uint16_t>(2000.0f + 200.0f * sinf(phase) + 0.5f);
+    }
+}
+
+// Same fields as the ESP32's ADC_DIGI_OUTPUT_FORMAT_TYPE1 result.
+struct Type1Result {
+    struct {
+        uint16_t data : 12;
+        uint16_t channel : 4;
+    } type1;
+};
+
+void test_adc_frame_split_routes_each_channel() {
+    // ADC channels 3 and 6 are scanned; channel 0 results are strays.
+    const uint16_t levels[2] = {1000, 3000};
+    uint8_t channelIndex[8];
+    for (uint8_t& index : channelIndex) {
+        index = 2;
+    }
+    channelIndex[3] = 0;
+    channelIndex[6] = 1;
+
+    Type1Result frame[96];
+    for (size_t i = 0; i < 96; ++i) {
+        uint8_t slot = static_cast<uint8_t>(i % 3);
+        frame[i].type1.channel = slot == 0 ? 3 : (slot == 1 ? 6 : 0);
+        frame[i].type1.data = slot == 2 ? 4095 : levels[slot];
+    }
+
+    uint16_t streams[2][64];
+    size_t counts[2];
+    DecimationChain chains[2];
+    SampleRing<256> rings[2];
+    uint16_t decimated[33];
+    for (int pass = 0; pass < 6; ++pass) {
+        splitAdcFrame(frame, 96, channelIndex, 8, streams, counts);
+        for (size_t c = 0; c < 2; ++c) {
+            TEST_ASSERT_EQUAL_UINT32(32, counts[c]);
+            for (size_t i = 0; i < counts[c]; ++i) {
+                TEST_ASSERT_EQUAL_UINT32(levels[c], streams[c][i]);
+            }
+            size_t produced = chains[c].process(streams[c], counts[c], decimated);
+            for (size_t i = 0; i < produced; ++i) {
+                rings[c].push(decimated[i]);
+            }
+        }
+    }
+
+    // Past the filter start-up, each ring holds only its own channel's level.
+    uint16_t out[256];
+    for (size_t c = 0; c < 2; ++c) {
+        size_t count = rings[c].drain(out, 256);
+        TEST_ASSERT_TRUE(count > 40);
+        for (size_t i = 20; i < count; ++i) {
+            TEST_ASSERT_UINT32_WITHIN(16, levels[c] << DecimationChain::FRACTION_BITS, out[i]);
+        }
+    }
+}
+
+void test_decimation_chain_rejects_slosh() {
+    DecimationChain chain;
+    chain.configure(2000);
+    TEST_ASSERT_EQUAL_UINT32(2000, chain.decimation());
+    uint16_t block[DecimationChain::BLOCK];
+    uint16_t out[DecimationChain::BLOCK / 2 + 1];
+    uint32_t sampleIndex = 0;
+    size_t outputs = 0;
+    for (int i = 0; i < 60000 / static_cast<int>(DecimationChain::BLOCK); ++i) {
+        fillSloshBlock(block, DecimationChain::BLOCK, sampleIndex);
+        size_t produced = chain.process(block, DecimationChain::BLOCK, out);
+        for (size_t j = 0; j < produced; ++j, ++outputs) {
+            // Once the FIR has flushed its primed history, within a quarter
+            // count of the mean (Q12.4).
+            if (outputs >= DECIMATION_FIR_TAPS / 2) {
+                TEST_ASSERT_UINT32_WITHIN(4, 2000u << DecimationChain::FRACTION_BITS, out[j]);
+            }
+        }
+    }
+    TEST_ASSERT_UINT32_WITHIN(2, 29, outputs);
+}
+
+void test_decimation_chain_benchmark() {
+    DecimationChain chain;
+    chain.configure(2000);
+    uint16_t block[DecimationChain::BLOCK];
+    uint16_t out[DecimationChain::BLOCK / 2 + 1];
+    uint32_t sampleIndex = 0;
+    fillSloshBlock(block, DecimationChain::BLOCK, sampleIndex);
+    const size_t blocks = 20000 / DecimationChain::BLOCK;
+    uint32_t start = micros();
+    for (size_t i = 0; i < blocks; ++i) {
+        chain.process(block, DecimationChain::BLOCK, out);
+    }
+    uint32_t elapsed = micros() - start;
+    char message[64];
+    snprintf(message, sizeof(message), "decimation: %lu us per second of 20 kHz input",
+             static_cast<unsigned long>(elapsed));
+    // Report only: wall-clock time depends on the target and its load.
+    TEST_MESSAGE(message);
+}
+
+void test_kalman_tracks_fill_after_steady_state() {
+    utils::LevelKalmanFilter filter;
+    filter.reset();
+    uint32_t seed = 7;
+    auto noise = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return (static_cast<float>(seed >> 8) / 8388608.0f - 1.0f) * 2.0f;  // ±2 mm
+    };
+    for (int i = 0; i < 200; ++i) {
+        filter.update(1000.0f + noise(), 1.33f, 1.0f);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 1000.0f, filter.depthMm());
+    TEST_ASSERT_TRUE(filter.depthVarianceMm2() < 1.33f);
+
+    // Fill at 5 mm/s: process noise opens up and the lag settles.
+    float truth = 1000.0f;
+    for (int i = 0; i < 60; ++i) {
+        truth += 5.0f;
+        filter.update(truth + noise(), 1.33f, 1.0f);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(4.0f, truth, filter.depthMm());
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 5.0f, filter.velocityMmPerSec());
+    TEST_ASSERT_TRUE(!isnan(filter.innovationMm()));
+}
+
 void setup() {
     delay(2000);
     UNITY_BEGIN();
     RUN_TEST(test_pulses_to_flow);
     RUN_TEST(test_voltage_to_height);
+    RUN_TEST(test_rolling_percentile_matches_sorted);
+    RUN_TEST(test_rolling_quantiles_match_single_calls);
+    RUN_TEST(test_fixed_rolling_stats_wraps_without_allocating);
+    RUN_TEST(test_rolling_min_max_follow_evictions);
+    RUN_TEST(test_quantile_sketch_within_error_bound);
+    RUN_TEST(test_quantile_sketch_clamps_small_horizon);
+    RUN_TEST(test_float_kernels_match_double_reference);
+    RUN_TEST(test_downsample_horizons_roll_over);
+    RUN_TEST(test_totalizer_records_rotate_over_slots);
+    RUN_TEST(test_totalizer_recovers_past_corrupt_newest_slot);
+    RUN_TEST(test_totalizer_recovers_across_sequence_wrap);
+    RUN_TEST(test_analytics_recompute_only_when_changed);
+    RUN_TEST(test_flow_state_round_trip);
+    RUN_TEST(test_checkpoint_blob_rejects_bad_saves);
+    RUN_TEST(test_checkpoint_policy_limits_saves_and_restores);
+    RUN_TEST(test_synthetic_capture_drains_newest_periods);
+    RUN_TEST(test_period_statistics_cover_every_pulse);
+    RUN_TEST(test_reciprocal_flow_estimator);
+    RUN_TEST(test_overflow_counter_folds_wraps);
+    RUN_TEST(test_unit_allocator_hands_out_each_unit_once);
+    RUN_TEST(test_overflow_counter_retries_across_isr);
+    RUN_TEST(test_edge_cross_check_splits_divergence);
+    RUN_TEST(test_level_samples_reduce_since_last_read);
+    RUN_TEST(test_level_reading_without_samples_is_missing);
+    RUN_TEST(test_sample_reduction_matches_sorted_reference);
+    RUN_TEST(test_voltage_table_interpolates_fraction_bits);
+    RUN_TEST(test_oversample_meets_standard_error_target);
+    RUN_TEST(test_adc_frame_split_routes_each_channel);
+    RUN_TEST(test_decimation_chain_rejects_slosh);
+    RUN_TEST(test_decimation_chain_benchmark);
+    RUN_TEST(test_kalman_tracks_fill_after_steady_state);
     UNITY_END();
 }
 